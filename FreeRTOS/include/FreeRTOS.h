@@ -546,6 +546,33 @@ extern "C" {
 	#define traceTASK_INCREMENT_TICK( xTickCount )
 #endif
 
+#ifndef traceENTER_CRITICAL
+	/* Called after the critical nesting count has been incremented, with
+	interrupts masked. */
+	#define traceENTER_CRITICAL( uxCriticalNesting )
+#endif
+
+#ifndef traceEXIT_CRITICAL
+	/* Called after the critical nesting count has been decremented, before
+	interrupts are unmasked. */
+	#define traceEXIT_CRITICAL( uxCriticalNesting )
+#endif
+
+#ifndef traceSUSPEND_ALL
+	/* Called after uxSchedulerSuspended has been incremented. */
+	#define traceSUSPEND_ALL( uxSchedulerSuspended )
+#endif
+
+#ifndef traceRESUME_ALL
+	/* Called before uxSchedulerSuspended is decremented. */
+	#define traceRESUME_ALL( uxSchedulerSuspended )
+#endif
+
+#ifndef traceTICK_INTERRUPT
+	/* Called on entry to the tick interrupt handler. */
+	#define traceTICK_INTERRUPT()
+#endif
+
 #ifndef traceTIMER_CREATE
 	#define traceTIMER_CREATE( pxNewTimer )
 #endif
@@ -85,8 +85,15 @@
 
 extern uint32_t SystemCoreClock;
 
+/* Set to 1 to paint every task stack, trap stack overflows and have the stack
+profiler task (stackprofile.c) record a recommended size for each task. */
+#define configSTACK_PROFILING			0
 
-#define configUSE_PREEMPTION			0
+/* Set to 1 to have criticalprofile.c time every critical section and scheduler
+suspension by call site, along with the tick interrupt's latency. */
+#define configCRITICAL_PROFILING		0
+
+#define configUSE_PREEMPTION			1
 #define configUSE_IDLE_HOOK				0
 #define configUSE_TICK_HOOK				0
 #define configCPU_CLOCK_HZ				( SystemCoreClock )
@@ -100,7 +107,11 @@ extern uint32_t SystemCoreClock;
 #define configIDLE_SHOULD_YIELD			1
 #define configUSE_MUTEXES				1
 #define configQUEUE_REGISTRY_SIZE		8
-#define configCHECK_FOR_STACK_OVERFLOW	0
+#if configSTACK_PROFILING == 1
+	#define configCHECK_FOR_STACK_OVERFLOW	2
+#else
+	#define configCHECK_FOR_STACK_OVERFLOW	0
+#endif
 #define configUSE_RECURSIVE_MUTEXES		1
 #define configUSE_MALLOC_FAILED_HOOK	0
 #define configUSE_APPLICATION_TASK_TAG	0
@@ -126,6 +137,10 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend			1
 #define INCLUDE_vTaskDelayUntil			1
 #define INCLUDE_vTaskDelay				1
+#define INCLUDE_xTaskGetCurrentTaskHandle	1
+#define INCLUDE_uxTaskGetStackHighWaterMark	configSTACK_PROFILING
+#define INCLUDE_xTaskGetIdleTaskHandle	configSTACK_PROFILING
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle	configSTACK_PROFILING
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -152,6 +167,27 @@ to all Cortex-M ports, and do not rely on any particular library functions. */
 See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
 #define configMAX_SYSCALL_INTERRUPT_PRIORITY 	( configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS) )
 	
+#if configCRITICAL_PROFILING == 1
+	/* The address the kernel function that calls the hook was called from. */
+	#if defined( __CC_ARM )
+		#define profileCallSite()	( ( uint32_t ) __return_address() )
+	#else
+		#define profileCallSite()	( ( uint32_t ) __builtin_return_address( 0 ) )
+	#endif
+
+	extern void profileEnterCritical( uint32_t, uint32_t );
+	extern void profileExitCritical( uint32_t );
+	extern void profileSuspendAll( uint32_t, uint32_t );
+	extern void profileResumeAll( uint32_t );
+	extern void profileTickInterrupt( void );
+
+	#define traceENTER_CRITICAL( uxCriticalNesting )	profileEnterCritical( uxCriticalNesting, profileCallSite() )
+	#define traceEXIT_CRITICAL( uxCriticalNesting )		profileExitCritical( uxCriticalNesting )
+	#define traceSUSPEND_ALL( uxSchedulerSuspended )	profileSuspendAll( uxSchedulerSuspended, profileCallSite() )
+	#define traceRESUME_ALL( uxSchedulerSuspended )		profileResumeAll( uxSchedulerSuspended )
+	#define traceTICK_INTERRUPT()						profileTickInterrupt()
+#endif
+
 /* Normal assert() semantics without relying on the provision of an assert.h
 header file. */
 #define configASSERT( x ) if( ( x ) == 0 ) { taskDISABLE_INTERRUPTS(); for( ;; ); }	
@@ -430,6 +430,7 @@ void vPortEnterCritical( void )
 {
 	portDISABLE_INTERRUPTS();
 	uxCriticalNesting++;
+	traceENTER_CRITICAL( uxCriticalNesting );
 
 	/* This is not the interrupt safe version of the enter critical function so
 	assert() if it is being called from an interrupt context.  Only API
@@ -447,6 +448,7 @@ void vPortExitCritical( void )
 {
 	configASSERT( uxCriticalNesting );
 	uxCriticalNesting--;
+	traceEXIT_CRITICAL( uxCriticalNesting );
 	if( uxCriticalNesting == 0 )
 	{
 		portENABLE_INTERRUPTS();
@@ -518,6 +520,8 @@ __asm void xPortPendSVHandler( void )
 
 void xPortSysTickHandler( void )
 {
+	traceTICK_INTERRUPT();
+
 	/* The SysTick runs at the lowest interrupt priority, so when this interrupt
 	executes all interrupts must be unmasked.  There is therefore no need to
 	save and then restore the interrupt mask value as its value is already
@@ -1948,6 +1948,7 @@ void vTaskSuspendAll( void )
 	post in the FreeRTOS support forum before reporting this as a bug! -
 	http://goo.gl/wu4acr */
 	++uxSchedulerSuspended;
+	traceSUSPEND_ALL( uxSchedulerSuspended );
 }
 /*----------------------------------------------------------*/
 
@@ -2030,6 +2031,7 @@ BaseType_t xAlreadyYielded = pdFALSE;
 	tasks from this list into their appropriate ready list. */
 	taskENTER_CRITICAL();
 	{
+		traceRESUME_ALL( uxSchedulerSuspended );
 		--uxSchedulerSuspended;
 
 		if( uxSchedulerSuspended == ( UBaseType_t ) pdFALSE )
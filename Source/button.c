@@ -0,0 +1,120 @@
+#include "button.h"
+
+#include "stm32f4xx_exti.h"
+#include "stm32f4xx_tim.h"
+#include "misc.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+// press lengths in ms
+#define DEBOUNCE_TIME 20
+#define SHORT_PRESS_TIME 100
+#define LONG_PRESS_TIME 1000
+
+#define BUTTON_QUEUE_LENGTH 4
+
+#define DEBOUNCE_TIMER TIM2
+#define DEBOUNCE_TIMER_IRQn TIM2_IRQn
+#define DEBOUNCE_TIMER_HZ 10000
+#define BUTTON_IRQ_PRIORITY configLIBRARY_LOWEST_INTERRUPT_PRIORITY
+
+static xQueueHandle xButtonQueue;
+static uint32_t pressed = 0;
+static TickType_t pressedAt;
+
+/*
+ * TIM2 is set up as a one shot timer. Every edge on the button restarts it, and the
+ * button is only read once it expires with no further bouncing.
+ */
+static void initializeDebounceTimer() {
+	TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+	
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+	
+	// APB1 timers run at twice the APB1 clock, which is SystemCoreClock / 4
+	TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
+	TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / 2) / DEBOUNCE_TIMER_HZ - 1;
+	TIM_TimeBaseStructure.TIM_Period = DEBOUNCE_TIME * (DEBOUNCE_TIMER_HZ / 1000) - 1;
+	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(DEBOUNCE_TIMER, &TIM_TimeBaseStructure);
+	TIM_SelectOnePulseMode(DEBOUNCE_TIMER, TIM_OPMode_Single);
+	
+	// TimeBaseInit generates an update event to load the prescaler, don't treat it as a timeout
+	TIM_ClearITPendingBit(DEBOUNCE_TIMER, TIM_IT_Update);
+	TIM_ITConfig(DEBOUNCE_TIMER, TIM_IT_Update, ENABLE);
+	
+	NVIC_InitStructure.NVIC_IRQChannel = DEBOUNCE_TIMER_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = BUTTON_IRQ_PRIORITY;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&NVIC_InitStructure);
+}
+
+void initializeButton() {
+	EXTI_InitTypeDef EXTI_InitStructure;
+	
+	xButtonQueue = xQueueCreate(BUTTON_QUEUE_LENGTH, sizeof(ButtonPress));
+	initializeDebounceTimer();
+	
+	// PBInit only listens for the press, we also need the release to time it
+	STM_EVAL_PBInit(BUTTON_USER, BUTTON_MODE_EXTI);
+	EXTI_InitStructure.EXTI_Line = USER_BUTTON_EXTI_LINE;
+	EXTI_InitStructure.EXTI_Mode = EXTI_Mode_Interrupt;
+	EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising_Falling;
+	EXTI_InitStructure.EXTI_LineCmd = ENABLE;
+	EXTI_Init(&EXTI_InitStructure);
+}
+
+/*
+ * Block for up to timeout ticks until the button is released after a short or
+ * long press. Uses no CPU while the button is idle. Returns 0 on a timeout.
+ */
+uint32_t waitForButtonPress(ButtonPress *press, TickType_t timeout) {
+	return xQueueReceive(xButtonQueue, press, timeout) == pdTRUE;
+}
+
+/*
+ * An edge on the button: (re)start the debounce timer and let it settle.
+ */
+void EXTI0_IRQHandler(void) {
+	if(EXTI_GetITStatus(USER_BUTTON_EXTI_LINE) != RESET) {
+		EXTI_ClearITPendingBit(USER_BUTTON_EXTI_LINE);
+		TIM_SetCounter(DEBOUNCE_TIMER, 0);
+		TIM_Cmd(DEBOUNCE_TIMER, ENABLE);
+	}
+}
+
+/*
+ * The button has been stable for DEBOUNCE_TIME. Time stamp a press, or classify
+ * a release by how long the button was held.
+ */
+void TIM2_IRQHandler(void) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	TickType_t heldFor;
+	ButtonPress press;
+	
+	if(TIM_GetITStatus(DEBOUNCE_TIMER, TIM_IT_Update) == RESET) {
+		return;
+	}
+	TIM_ClearITPendingBit(DEBOUNCE_TIMER, TIM_IT_Update);
+	
+	if(STM_EVAL_PBGetState(BUTTON_USER)) {
+		if(!pressed) {
+			pressed = 1;
+			pressedAt = xTaskGetTickCountFromISR();
+		}
+	} else if(pressed) {
+		pressed = 0;
+		heldFor = (xTaskGetTickCountFromISR() - pressedAt) * portTICK_RATE_MS;
+		
+		if(heldFor >= SHORT_PRESS_TIME) {
+			press = heldFor >= LONG_PRESS_TIME ? LONG_PRESS : SHORT_PRESS;
+			xQueueSendFromISR(xButtonQueue, &press, &xHigherPriorityTaskWoken);
+		}
+	}
+	
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
@@ -0,0 +1,15 @@
+#ifndef _BUTTON_H
+#define _BUTTON_H
+
+#include "discoveryf4utils.h"
+#include "FreeRTOS.h"
+
+typedef enum {
+	SHORT_PRESS,
+	LONG_PRESS
+} ButtonPress;
+
+void initializeButton(void);
+uint32_t waitForButtonPress(ButtonPress *, TickType_t);
+
+#endif
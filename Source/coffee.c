@@ -5,20 +5,57 @@
 #define BREW_TIME_MOCHA 6000
 #define BREW_TIME_CAPPUCCINO 4000
 
+// Shorter brew for a Coffee that has fallen behind and uses OVERLOAD_DEGRADE
+#define DEGRADED_BREW_TIME_LATTE 2000
+#define DEGRADED_BREW_TIME_ESPRESSO 2000
+#define DEGRADED_BREW_TIME_MOCHA 3000
+#define DEGRADED_BREW_TIME_CAPPUCCINO 2000
+
+// What happens to a Coffee's jobs under overload. Tools/overload_sim.c compares the options.
+#define OVERLOAD_LATTE OVERLOAD_RUN_LATE
+#define OVERLOAD_ESPRESSO OVERLOAD_RUN_LATE
+#define OVERLOAD_MOCHA OVERLOAD_RUN_LATE
+#define OVERLOAD_CAPPUCCINO OVERLOAD_RUN_LATE
+
 #define PRIORITY_LATTE 1
 #define PRIORITY_ESPRESSO 3
 #define PRIORITY_MOCHA 2
 #define PRIORITY_CAPPUCCINO 2
 
-#define PERIOD_LATTE 30
-#define PERIOD_ESPRESSO 20
-#define PERIOD_MOCHA 40
-#define PERIOD_CAPPUCCINO 40
+// Periods and relative deadlines in ms
+#define PERIOD_LATTE 30000
+#define PERIOD_ESPRESSO 20000
+#define PERIOD_MOCHA 40000
+#define PERIOD_CAPPUCCINO 40000
+
+#define DEADLINE_LATTE 10000
+#define DEADLINE_ESPRESSO 5000
+#define DEADLINE_MOCHA 15000
+#define DEADLINE_CAPPUCCINO 10000
+
+// Extra ms every brew of a Coffee really takes over its brew time. Only for trying out
+// CONSTANT_BANDWIDTH_SERVER with a Coffee that overruns.
+#define OVERRUN_LATTE 0
+#define OVERRUN_ESPRESSO 0
+#define OVERRUN_MOCHA 0
+#define OVERRUN_CAPPUCCINO 0
+
+// Each Coffee's CONSTANT_BANDWIDTH_SERVER reservation: this many ms of brewing every period
+#define RESERVATION_BUDGET_LATTE BREW_TIME_LATTE
+#define RESERVATION_BUDGET_ESPRESSO BREW_TIME_ESPRESSO
+#define RESERVATION_BUDGET_MOCHA BREW_TIME_MOCHA
+#define RESERVATION_BUDGET_CAPPUCCINO BREW_TIME_CAPPUCCINO
 
-#define DEADLINE_LATTE 10
-#define DEADLINE_ESPRESSO 5
-#define DEADLINE_MOCHA 15
-#define DEADLINE_CAPPUCCINO 10
+#define RESERVATION_PERIOD_LATTE PERIOD_LATTE
+#define RESERVATION_PERIOD_ESPRESSO PERIOD_ESPRESSO
+#define RESERVATION_PERIOD_MOCHA PERIOD_MOCHA
+#define RESERVATION_PERIOD_CAPPUCCINO PERIOD_CAPPUCCINO
+
+// Completion chime pitch in Hz. Pitches that divide 48000 evenly keep the chime's wavetable short.
+#define CHIME_LATTE 360
+#define CHIME_ESPRESSO 480
+#define CHIME_MOCHA 240
+#define CHIME_CAPPUCCINO 300
 
 static Coffee selected;
 
@@ -69,6 +106,36 @@ uint32_t getBrewDurations(Coffee type) {
 	}
 }
 
+uint32_t getDegradedBrewDuration(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return DEGRADED_BREW_TIME_LATTE;
+		case ESPRESSO:
+			return DEGRADED_BREW_TIME_ESPRESSO;
+		case MOCHA:
+			return DEGRADED_BREW_TIME_MOCHA;
+		case CAPPUCCINO:
+			return DEGRADED_BREW_TIME_CAPPUCCINO;
+		default:
+			return 0;
+	}
+}
+
+OverloadPolicy getCoffeeOverloadPolicy(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return OVERLOAD_LATTE;
+		case ESPRESSO:
+			return OVERLOAD_ESPRESSO;
+		case MOCHA:
+			return OVERLOAD_MOCHA;
+		case CAPPUCCINO:
+			return OVERLOAD_CAPPUCCINO;
+		default:
+			return OVERLOAD_RUN_LATE;
+	}
+}
+
 uint32_t getCoffeePriority(Coffee type) {
 	switch(type) {
 		case LATTE:
@@ -113,3 +180,78 @@ uint32_t getCoffeeDeadline(Coffee type) {
 			return 0;
 	}
 }
+
+uint32_t getBrewOverrun(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return OVERRUN_LATTE;
+		case ESPRESSO:
+			return OVERRUN_ESPRESSO;
+		case MOCHA:
+			return OVERRUN_MOCHA;
+		case CAPPUCCINO:
+			return OVERRUN_CAPPUCCINO;
+		default:
+			return 0;
+	}
+}
+
+uint32_t getReservationBudget(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return RESERVATION_BUDGET_LATTE;
+		case ESPRESSO:
+			return RESERVATION_BUDGET_ESPRESSO;
+		case MOCHA:
+			return RESERVATION_BUDGET_MOCHA;
+		case CAPPUCCINO:
+			return RESERVATION_BUDGET_CAPPUCCINO;
+		default:
+			return 0;
+	}
+}
+
+uint32_t getReservationPeriod(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return RESERVATION_PERIOD_LATTE;
+		case ESPRESSO:
+			return RESERVATION_PERIOD_ESPRESSO;
+		case MOCHA:
+			return RESERVATION_PERIOD_MOCHA;
+		case CAPPUCCINO:
+			return RESERVATION_PERIOD_CAPPUCCINO;
+		default:
+			return 0;
+	}
+}
+
+uint32_t getCoffeeChimeFrequency(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return CHIME_LATTE;
+		case ESPRESSO:
+			return CHIME_ESPRESSO;
+		case MOCHA:
+			return CHIME_MOCHA;
+		case CAPPUCCINO:
+			return CHIME_CAPPUCCINO;
+		default:
+			return CHIME_LATTE;
+	}
+}
+
+const char *getCoffeeName(Coffee type) {
+	switch(type) {
+		case LATTE:
+			return "latte";
+		case ESPRESSO:
+			return "espresso";
+		case MOCHA:
+			return "mocha";
+		case CAPPUCCINO:
+			return "cappuccino";
+		default:
+			return "";
+	}
+}
@@ -2,6 +2,7 @@
 #define _COFFEE_H
 
 #include "discoveryf4utils.h"
+#include "job.h"
 
 typedef enum {
 	LATTE = LED_GREEN,
@@ -16,9 +17,16 @@ Coffee changeSelected(void);
 Led_TypeDef getLEDForSelected(void);
 Led_TypeDef getLEDForCoffeeType(Coffee);
 uint32_t getBrewDurations(Coffee);
+uint32_t getDegradedBrewDuration(Coffee);
+OverloadPolicy getCoffeeOverloadPolicy(Coffee);
 uint32_t getCoffeePriority(Coffee);
 uint32_t getCoffeePeriod(Coffee);
 uint32_t getCoffeeDeadline(Coffee);
+uint32_t getBrewOverrun(Coffee);
+uint32_t getReservationBudget(Coffee);
+uint32_t getReservationPeriod(Coffee);
+uint32_t getCoffeeChimeFrequency(Coffee);
+const char *getCoffeeName(Coffee);
 Coffee getSelectedCoffee(void);
 
 #endif
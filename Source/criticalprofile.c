@@ -0,0 +1,113 @@
+#include "criticalprofile.h"
+
+#if configCRITICAL_PROFILING == 1
+
+CriticalProfile criticalProfiles[CRITICAL_PROFILE_MAX_SITES];
+uint32_t criticalProfileCount = 0;
+uint32_t criticalProfileMissedSites = 0;	// sections from sites that didn't fit in criticalProfiles
+
+// Worst cycles from the SysTick firing to its handler running
+uint32_t maxTickLatency = 0;
+uint32_t tickLatencyHistogram[CRITICAL_PROFILE_BUCKETS];
+
+static uint32_t maskedSite;
+static uint32_t maskedSince;
+static uint32_t suspendedSite;
+static uint32_t suspendedSince;
+
+/*
+ * Start the DWT cycle counter the profiler times everything with. Sections that
+ * end before this is called aren't timed.
+ */
+void initializeCriticalProfiler() {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static uint32_t getBucket(uint32_t cycles) {
+	uint32_t bucket = 0;
+	uint32_t limit = 64;
+	
+	while(bucket < CRITICAL_PROFILE_BUCKETS - 1 && cycles >= limit) {
+		bucket++;
+		limit <<= 2;
+	}
+	return bucket;
+}
+
+/*
+ * Add one section to its call site's profile. Always runs with interrupts masked,
+ * so the profiles can't change underneath it.
+ */
+static void recordSection(uint32_t site, CriticalKind kind, uint32_t cycles) {
+	CriticalProfile *profile = NULL;
+	uint32_t i;
+	
+	for(i = 0; i < criticalProfileCount && profile == NULL; i++) {
+		if(criticalProfiles[i].site == site && criticalProfiles[i].kind == kind) {
+			profile = &criticalProfiles[i];
+		}
+	}
+	if(profile == NULL) {
+		if(criticalProfileCount == CRITICAL_PROFILE_MAX_SITES) {
+			criticalProfileMissedSites++;
+			return;
+		}
+		profile = &criticalProfiles[criticalProfileCount++];
+		profile->site = site;
+		profile->kind = kind;
+	}
+	
+	profile->count++;
+	if(cycles > profile->maxCycles) {
+		profile->maxCycles = cycles;
+	}
+	profile->histogram[getBucket(cycles)]++;
+}
+
+/*
+ * The kernel's critical section and scheduler suspension hooks, see FreeRTOSConfig.h.
+ * Only the outermost of nested sections is timed.
+ */
+void profileEnterCritical(uint32_t nesting, uint32_t site) {
+	if(nesting == 1) {
+		maskedSite = site;
+		maskedSince = DWT->CYCCNT;
+	}
+}
+
+void profileExitCritical(uint32_t nesting) {
+	if(nesting == 0) {
+		recordSection(maskedSite, CRITICAL_MASKED, DWT->CYCCNT - maskedSince);
+	}
+}
+
+void profileSuspendAll(uint32_t depth, uint32_t site) {
+	if(depth == 1) {
+		suspendedSite = site;
+		suspendedSince = DWT->CYCCNT;
+	}
+}
+
+// Called from inside xTaskResumeAll's own critical section
+void profileResumeAll(uint32_t depth) {
+	if(depth == 1) {
+		recordSection(suspendedSite, CRITICAL_SUSPENDED, DWT->CYCCNT - suspendedSince);
+	}
+}
+
+/*
+ * The SysTick counts down from its reload value at the core clock and fires as it
+ * reloads, so how far it has counted since then is how long the handler took to start.
+ */
+void profileTickInterrupt() {
+	uint32_t latency = SysTick->LOAD - SysTick->VAL;
+	
+	if(latency > maxTickLatency) {
+		maxTickLatency = latency;
+	}
+	tickLatencyHistogram[getBucket(latency)]++;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _CRITICALPROFILE_H
+#define _CRITICALPROFILE_H
+
+#include "FreeRTOS.h"
+
+#define CRITICAL_PROFILE_MAX_SITES 24
+
+// Bucket i counts sections shorter than 64 << 2i cycles, the last one everything longer
+#define CRITICAL_PROFILE_BUCKETS 8
+
+typedef enum {
+	CRITICAL_MASKED,		// interrupts masked by taskENTER_CRITICAL
+	CRITICAL_SUSPENDED		// scheduler suspended by vTaskSuspendAll
+} CriticalKind;
+
+typedef struct {
+	uint32_t site;			// return address of the call that entered the section
+	CriticalKind kind;
+	uint32_t count;
+	uint32_t maxCycles;
+	uint32_t histogram[CRITICAL_PROFILE_BUCKETS];
+} CriticalProfile;
+
+#if configCRITICAL_PROFILING == 1
+extern CriticalProfile criticalProfiles[CRITICAL_PROFILE_MAX_SITES];
+extern uint32_t criticalProfileCount;
+extern uint32_t criticalProfileMissedSites;
+extern uint32_t maxTickLatency;
+extern uint32_t tickLatencyHistogram[CRITICAL_PROFILE_BUCKETS];
+
+void initializeCriticalProfiler(void);
+#else
+#define initializeCriticalProfiler()
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _CYCLICTABLE_H
+#define _CYCLICTABLE_H
+
+#include <stdint.h>
+
+// ms each entry of the table lasts, the same as SCHEDULER_DELAY
+#define CYCLIC_SLOT 1000
+
+/*
+ * What the table was generated for, one per Coffee in enum order. All times are in ms.
+ */
+typedef struct {
+	uint32_t work;
+	uint32_t period;
+	uint32_t deadline;
+} CyclicCatalogEntry;
+
+// Written by Tools/cyclic_table_gen.c, see cyclictable.c
+extern const CyclicCatalogEntry cyclicCatalog[];
+extern const uint32_t cyclicCatalogSize;
+extern const uint8_t cyclicTable[];
+extern const uint32_t cyclicTableSize;
+
+#endif
@@ -0,0 +1,252 @@
+#include "input.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "button.h"
+#include "job.h"
+#include "stm32f4xx_usart.h"
+#include "misc.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+// time in ms a second short press has to follow the first to make a double press
+#define DOUBLE_PRESS_TIME 400
+
+#define INPUT_QUEUE_LENGTH 16
+#define SERIAL_QUEUE_LENGTH 32
+#define SERIAL_LINE_LENGTH 40
+#define SERIAL_MAX_TOKENS 5
+
+// USART3 shares PC10 with the codec's I2S clock, so commands come in on USART2 (PA2/PA3)
+#define SERIAL_USART USART2
+#define SERIAL_BAUD_RATE 115200
+#define SERIAL_IRQn USART2_IRQn
+#define SERIAL_IRQ_PRIORITY configLIBRARY_LOWEST_INTERRUPT_PRIORITY
+
+static xQueueHandle xInputQueue;
+static xQueueHandle xSerialQueue;
+
+// Characters lost because the previous one hadn't been read yet
+uint32_t serialOverruns = 0;
+
+static void initializeSerial() {
+	GPIO_InitTypeDef GPIO_InitStructure;
+	USART_InitTypeDef USART_InitStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOA, ENABLE);
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
+
+	GPIO_PinAFConfig(GPIOA, GPIO_PinSource2, GPIO_AF_USART2);
+	GPIO_PinAFConfig(GPIOA, GPIO_PinSource3, GPIO_AF_USART2);
+	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_2 | GPIO_Pin_3;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
+	GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+	GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+	USART_StructInit(&USART_InitStructure);
+	USART_InitStructure.USART_BaudRate = SERIAL_BAUD_RATE;
+	USART_InitStructure.USART_Mode = USART_Mode_Rx;
+	USART_Init(SERIAL_USART, &USART_InitStructure);
+	USART_ITConfig(SERIAL_USART, USART_IT_RXNE, ENABLE);
+
+	NVIC_InitStructure.NVIC_IRQChannel = SERIAL_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = SERIAL_IRQ_PRIORITY;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&NVIC_InitStructure);
+
+	USART_Cmd(SERIAL_USART, ENABLE);
+}
+
+void initializeInput() {
+	xInputQueue = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(InputEvent));
+	xSerialQueue = xQueueCreate(SERIAL_QUEUE_LENGTH, sizeof(char));
+	initializeButton();
+	initializeSerial();
+}
+
+static void postInputEvent(InputEventType type, Coffee coffee, uint32_t count, int32_t delay) {
+	InputEvent event;
+
+	event.type = type;
+	event.coffee = coffee;
+	event.count = count;
+	event.at = delay;
+	xQueueSend(xInputQueue, &event, 0);
+}
+
+/*
+ * Take the next input event without waiting. Returns 0 when there are none.
+ */
+uint32_t receiveInputEvent(InputEvent *event) {
+	return xQueueReceive(xInputQueue, event, 0) == pdTRUE;
+}
+
+/*
+ * Turn button presses into single, double and long press events. A short press
+ * is held back for DOUBLE_PRESS_TIME to see if a second one follows it.
+ */
+void vButtonGestures(void *pvParameters) {
+	ButtonPress press;
+
+	for(;;) {
+		waitForButtonPress(&press, portMAX_DELAY);
+
+		if(press == LONG_PRESS) {
+			postInputEvent(INPUT_LONG_PRESS, DEFAULT_COFFEE, 1, 0);
+		} else if(!waitForButtonPress(&press, DOUBLE_PRESS_TIME / portTICK_RATE_MS)) {
+			postInputEvent(INPUT_SINGLE_PRESS, DEFAULT_COFFEE, 1, 0);
+		} else if(press == SHORT_PRESS) {
+			postInputEvent(INPUT_DOUBLE_PRESS, DEFAULT_COFFEE, 1, 0);
+		} else {
+			postInputEvent(INPUT_SINGLE_PRESS, DEFAULT_COFFEE, 1, 0);
+			postInputEvent(INPUT_LONG_PRESS, DEFAULT_COFFEE, 1, 0);
+		}
+	}
+}
+
+static Coffee parseCoffee(const char *name) {
+	uint32_t i;
+
+	for(i = 0; i < LEDn; i++) {
+		if(strcmp(name, getCoffeeName((Coffee)i)) == 0) {
+			return (Coffee)i;
+		}
+	}
+	return DEFAULT_COFFEE;
+}
+
+/*
+ * Parse a whole number no bigger than max. Returns -1 if the token isn't one.
+ */
+static int32_t parseNumber(const char *token, uint32_t max) {
+	char *end;
+	unsigned long value;
+
+	if(token[0] < '0' || token[0] > '9') {
+		return -1;
+	}
+	value = strtoul(token, &end, 10);
+	return *end == '\0' && value <= max ? (int32_t)value : -1;
+}
+
+/*
+ * Parse an optional "+seconds" start delay of up to SERIAL_MAX_DELAY. Returns -1 if
+ * the token is malformed or too long a delay.
+ */
+static int32_t parseDelay(const char *token) {
+	if(token == NULL) {
+		return 0;
+	}
+	if(token[0] != '+') {
+		return -1;
+	}
+	return parseNumber(&token[1], SERIAL_MAX_DELAY);
+}
+
+/*
+ * Commands, one per line. +seconds delays the command from when it is received.
+ *   press single|double|long
+ *   all [+seconds]
+ *   start <coffee> [+seconds]
+ *   order <count> <coffee> [+seconds]
+ * An order is for 1 to JOB_RING_SIZE coffees, since no more fit in a coffee's jobs.
+ * Anything that doesn't parse is ignored.
+ */
+static void parseCommand(char *line) {
+	char *tokens[SERIAL_MAX_TOKENS] = {NULL};
+	uint32_t tokenCount = 0;
+	char *token;
+	Coffee coffee;
+	int32_t count;
+	int32_t delay;
+
+	for(token = strtok(line, " \t"); token != NULL && tokenCount < SERIAL_MAX_TOKENS; token = strtok(NULL, " \t")) {
+		tokens[tokenCount++] = token;
+	}
+	if(tokenCount == 0) {
+		return;
+	}
+
+	if(strcmp(tokens[0], "press") == 0 && tokenCount == 2) {
+		if(strcmp(tokens[1], "single") == 0) {
+			postInputEvent(INPUT_SINGLE_PRESS, DEFAULT_COFFEE, 1, 0);
+		} else if(strcmp(tokens[1], "double") == 0) {
+			postInputEvent(INPUT_DOUBLE_PRESS, DEFAULT_COFFEE, 1, 0);
+		} else if(strcmp(tokens[1], "long") == 0) {
+			postInputEvent(INPUT_LONG_PRESS, DEFAULT_COFFEE, 1, 0);
+		}
+	} else if(strcmp(tokens[0], "all") == 0) {
+		delay = parseDelay(tokens[1]);
+		if(delay >= 0) {
+			postInputEvent(INPUT_START_ALL, DEFAULT_COFFEE, 1, delay);
+		}
+	} else if(strcmp(tokens[0], "start") == 0 && tokenCount >= 2) {
+		coffee = parseCoffee(tokens[1]);
+		delay = parseDelay(tokens[2]);
+		if(coffee != DEFAULT_COFFEE && delay >= 0) {
+			postInputEvent(INPUT_START, coffee, 1, delay);
+		}
+	} else if(strcmp(tokens[0], "order") == 0 && tokenCount >= 3) {
+		count = parseNumber(tokens[1], JOB_RING_SIZE);
+		coffee = parseCoffee(tokens[2]);
+		delay = parseDelay(tokens[3]);
+		if(count > 0 && coffee != DEFAULT_COFFEE && delay >= 0) {
+			postInputEvent(INPUT_ORDER, coffee, (uint32_t)count, delay);
+		}
+	}
+}
+
+/*
+ * Collect characters from the serial port into lines and turn each line into
+ * an input event.
+ */
+void vSerialCommands(void *pvParameters) {
+	char line[SERIAL_LINE_LENGTH];
+	uint32_t length = 0;
+	char c;
+
+	for(;;) {
+		xQueueReceive(xSerialQueue, &c, portMAX_DELAY);
+
+		if(c == '\r' || c == '\n') {
+			line[length] = '\0';
+			parseCommand(line);
+			length = 0;
+		} else if(length < SERIAL_LINE_LENGTH - 1) {
+			line[length++] = c;
+		}
+	}
+}
+
+/*
+ * RXNEIE also raises this interrupt on an overrun, and ORE is only cleared by reading
+ * SR and then DR. If it wasn't, the interrupt would fire again as soon as it returned.
+ */
+void USART2_IRQHandler(void) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	uint32_t overrun;
+	char c;
+
+	overrun = USART_GetFlagStatus(SERIAL_USART, USART_FLAG_ORE) != RESET;
+	if(USART_GetITStatus(SERIAL_USART, USART_IT_RXNE) != RESET) {
+		c = (char)USART_ReceiveData(SERIAL_USART);
+		xQueueSendFromISR(xSerialQueue, &c, &xHigherPriorityTaskWoken);
+	}
+
+	// A byte that came in between reading SR and DR above leaves ORE set on its own
+	if(USART_GetFlagStatus(SERIAL_USART, USART_FLAG_ORE) != RESET) {
+		USART_ReceiveData(SERIAL_USART);
+		overrun = 1;
+	}
+	if(overrun) {
+		serialOverruns++;
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
@@ -0,0 +1,30 @@
+#ifndef _INPUT_H
+#define _INPUT_H
+
+#include "coffee.h"
+
+// Longest +seconds delay a serial command can have, well short of overflowing the tick count
+#define SERIAL_MAX_DELAY 3600
+
+typedef enum {
+	INPUT_SINGLE_PRESS,
+	INPUT_DOUBLE_PRESS,
+	INPUT_LONG_PRESS,
+	INPUT_START,		// start brewing coffee every period
+	INPUT_START_ALL,	// start brewing every coffee every period
+	INPUT_ORDER			// brew count of coffee once
+} InputEventType;
+
+typedef struct {
+	InputEventType type;
+	Coffee coffee;
+	uint32_t count;
+	int32_t at;			// scheduler tick to apply the event at, relative to now until it is received
+} InputEvent;
+
+void initializeInput(void);
+uint32_t receiveInputEvent(InputEvent *);
+void vButtonGestures(void *);
+void vSerialCommands(void *);
+
+#endif
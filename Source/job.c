@@ -0,0 +1,154 @@
+#include "job.h"
+
+#include <stddef.h>
+
+/*
+ * Put every job of the pool on its free list.
+ */
+void initJobPool(JobPool *pool) {
+	uint32_t i;
+	
+	for(i = 0; i < JOB_POOL_SIZE; i++) {
+		pool->jobs[i].next = i + 1 < JOB_POOL_SIZE ? i + 1 : NO_JOB;
+	}
+	pool->free = 0;
+}
+
+/*
+ * Start a ring with no jobs, taking them from pool when they are released.
+ */
+void initJobRing(JobRing *ring, JobPool *pool) {
+	ring->pool = pool;
+	ring->head = NO_JOB;
+	ring->count = 0;
+	ring->dropped = 0;
+}
+
+/*
+ * Add a job to the ring. A periodic job goes ahead of the orders waiting for the same
+ * Coffee, so that orders can't hold up periodic jobs, but never ahead of one that has
+ * started brewing. Returns 0 and counts the job as dropped if the ring already has
+ * JOB_RING_SIZE jobs or the pool has none left.
+ */
+static uint32_t addJob(JobRing *ring, int32_t release, int32_t deadline, int32_t work, uint32_t aperiodic) {
+	JobPool *pool = ring->pool;
+	uint16_t slot = pool->free;
+	uint16_t after = NO_JOB;
+	uint16_t i;
+	Job *job;
+	
+	if(ring->count == JOB_RING_SIZE || slot == NO_JOB) {
+		ring->dropped++;
+		return 0;
+	}
+	pool->free = pool->jobs[slot].next;
+	
+	// After the last job, or for a periodic job the last one that isn't a waiting order
+	for(i = ring->head; i != NO_JOB; i = pool->jobs[i].next) {
+		if(aperiodic || !pool->jobs[i].aperiodic || pool->jobs[i].startTime != JOB_NOT_STARTED) {
+			after = i;
+		}
+	}
+	
+	job = &pool->jobs[slot];
+	job->release = release;
+	job->deadline = deadline;
+	job->remainingWork = work;
+	job->startTime = JOB_NOT_STARTED;
+	job->degraded = 0;
+	job->aperiodic = aperiodic;
+	if(after == NO_JOB) {
+		job->next = ring->head;
+		ring->head = slot;
+	} else {
+		job->next = pool->jobs[after].next;
+		pool->jobs[after].next = slot;
+	}
+	ring->count++;
+	return 1;
+}
+
+/*
+ * Add a periodic job to the ring, see addJob.
+ */
+uint32_t pushJob(JobRing *ring, int32_t release, int32_t deadline, int32_t work) {
+	return addJob(ring, release, deadline, work, 0);
+}
+
+/*
+ * Add a one-off order to the back of the ring. Its deadline is only used to order it,
+ * it can't be missed.
+ */
+uint32_t pushOrder(JobRing *ring, int32_t release, int32_t deadline, int32_t work) {
+	return addJob(ring, release, deadline, work, 1);
+}
+
+/*
+ * The oldest job in the ring, or NULL if there are none.
+ */
+Job *peekJob(JobRing *ring) {
+	if(ring->count == 0) {
+		return NULL;
+	}
+	return &ring->pool->jobs[ring->head];
+}
+
+/*
+ * The job after the oldest, or NULL if there isn't one.
+ */
+Job *peekNextJob(JobRing *ring) {
+	if(ring->count < 2) {
+		return NULL;
+	}
+	return &ring->pool->jobs[ring->pool->jobs[ring->head].next];
+}
+
+/*
+ * Remove the oldest job and give it back to the pool.
+ */
+void popJob(JobRing *ring) {
+	JobPool *pool = ring->pool;
+	uint16_t slot = ring->head;
+	
+	if(ring->count == 0) {
+		return;
+	}
+	ring->head = pool->jobs[slot].next;
+	pool->jobs[slot].next = pool->free;
+	pool->free = slot;
+	ring->count--;
+}
+
+/*
+ * Drop every job whose deadline passed before now, up to the first order.
+ * Returns how many were dropped.
+ */
+uint32_t abortLateJobs(JobRing *ring, int32_t now) {
+	uint32_t aborted = 0;
+	Job *job;
+	
+	while((job = peekJob(ring)) != NULL && !job->aperiodic && job->deadline < now) {
+		popJob(ring);
+		aborted++;
+	}
+	return aborted;
+}
+
+/*
+ * If the oldest job can't finish by its deadline, take saving off its remaining
+ * work. A job is only degraded once, and orders never are. Returns 1 if it was degraded.
+ */
+uint32_t degradeLateJob(JobRing *ring, int32_t now, int32_t saving) {
+	Job *job = peekJob(ring);
+	
+	if(job == NULL || job->degraded || job->aperiodic || now + job->remainingWork <= job->deadline) {
+		return 0;
+	}
+	
+	job->remainingWork -= saving;
+	if(job->remainingWork < 0) {
+		job->remainingWork = 0;
+	}
+	job->degraded = 1;
+	return 1;
+}
@@ -0,0 +1,70 @@
+#ifndef _JOB_H
+#define _JOB_H
+
+#include <stdint.h>
+
+// Most jobs one Coffee can have waiting
+#define JOB_RING_SIZE 8
+
+// Jobs all the Coffees sharing a JobPool can have waiting together
+#define JOB_POOL_SIZE 32
+
+#define NO_JOB 0xFFFF
+
+#define JOB_NOT_STARTED -1
+
+/*
+ * What to do with a Coffee's jobs once there is more work than time.
+ */
+typedef enum {
+	OVERLOAD_RUN_LATE,	// brew late jobs to completion anyway
+	OVERLOAD_ABORT,		// drop a job as soon as its deadline has passed
+	OVERLOAD_SKIP,		// skip a release while an earlier job is still waiting (skip-over)
+	OVERLOAD_DEGRADE	// brew a job that can no longer make its deadline for a shorter time
+} OverloadPolicy;
+
+/*
+ * One released instance of a periodic or ordered Coffee. Times are in kernel ticks.
+ */
+typedef struct {
+	int32_t release;
+	int32_t deadline;		// absolute
+	int32_t remainingWork;
+	int32_t startTime;		// JOB_NOT_STARTED until it first gets to brew
+	uint8_t degraded;
+	uint8_t aperiodic;		// a one-off order rather than a periodic release
+	uint16_t next;			// the next job in its ring or the free list, or NO_JOB
+} Job;
+
+/*
+ * Jobs handed out to the rings that share it as they are released, so a Coffee only
+ * takes room for the jobs it actually has waiting.
+ */
+typedef struct {
+	Job jobs[JOB_POOL_SIZE];
+	uint16_t free;
+} JobPool;
+
+/*
+ * The jobs of one Coffee type waiting to brew, oldest first, linked through its
+ * JobPool. Jobs of a type are brewed in the order they were released, except that
+ * periodic jobs go ahead of one-off orders that haven't started.
+ */
+typedef struct {
+	JobPool *pool;
+	uint16_t head;
+	uint16_t count;
+	uint32_t dropped;		// releases that found the ring or the pool full
+} JobRing;
+
+void initJobPool(JobPool *);
+void initJobRing(JobRing *, JobPool *);
+uint32_t pushJob(JobRing *, int32_t, int32_t, int32_t);
+uint32_t pushOrder(JobRing *, int32_t, int32_t, int32_t);
+Job *peekJob(JobRing *);
+Job *peekNextJob(JobRing *);
+void popJob(JobRing *);
+uint32_t abortLateJobs(JobRing *, int32_t);
+uint32_t degradeLateJob(JobRing *, int32_t, int32_t);
+
+#endif
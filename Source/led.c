@@ -1,33 +1,161 @@
 #include "led.h"
 
-#include "FreeRTOS.h"
-#include "task.h"
+#include "stm32f4xx_tim.h"
+#include "stm32f4xx_dma.h"
+
+/*
+ * The four LEDs are on TIM4's PWM channels. Brightness is the PWM duty cycle and
+ * blinking comes from a one second table of duty cycles that the DMA copies into
+ * the compare registers on every PWM period. Setting a pattern rewrites that LED's
+ * column of the table once; after that the LEDs cost no CPU time at all.
+ */
+#define LED_PWM_HZ 100
+#define LED_TIMER_HZ (LED_PWM_HZ * LED_FULL_BRIGHTNESS)
+#define LED_FRAMES LED_PWM_HZ		// one second of patterns
+#define LED_CHANNELS 4
+
+#define LED_TIMER TIM4
+#define LED_DMA_STREAM DMA1_Stream6	// TIM4_UP
+#define LED_DMA_CHANNEL DMA_Channel_2
+
+// TIM4 channel (minus one) driving each Led_TypeDef
+static const uint8_t LED_CHANNEL[LEDn] = {0, 3, 2, 1};
+static const uint16_t LED_PIN_SOURCE[LEDn] = {GPIO_PinSource12, GPIO_PinSource15, GPIO_PinSource14, GPIO_PinSource13};
+
+// Compare values for CCR1-CCR4, one row per PWM period
+static uint16_t ledFrames[LED_FRAMES][LED_CHANNELS];
+
+static LedPattern currentPattern[LEDn];
+static uint32_t currentBrightness[LEDn];
+
+static void initializeLEDPins() {
+	GPIO_InitTypeDef GPIO_InitStructure;
+	uint32_t i;
+	
+	RCC_AHB1PeriphClockCmd(LED_GREEN_GPIO_CLK, ENABLE);
+	
+	GPIO_InitStructure.GPIO_Pin = LED_GREEN_PIN | LED_ORANGE_PIN | LED_RED_PIN | LED_BLUE_PIN;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
+	GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+	GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(LED_GREEN_GPIO_PORT, &GPIO_InitStructure);
+	
+	for(i = 0; i < LEDn; i++) {
+		GPIO_PinAFConfig(LED_GREEN_GPIO_PORT, LED_PIN_SOURCE[i], GPIO_AF_TIM4);
+	}
+}
+
+static void initializeLEDTimer() {
+	TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+	TIM_OCInitTypeDef TIM_OCInitStructure;
+	
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4, ENABLE);
+	
+	// APB1 timers run at twice the APB1 clock, which is SystemCoreClock / 4
+	TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
+	TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / 2) / LED_TIMER_HZ - 1;
+	TIM_TimeBaseStructure.TIM_Period = LED_FULL_BRIGHTNESS - 1;
+	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(LED_TIMER, &TIM_TimeBaseStructure);
+	
+	TIM_OCStructInit(&TIM_OCInitStructure);
+	TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+	TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+	TIM_OCInitStructure.TIM_Pulse = 0;
+	TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+	TIM_OC1Init(LED_TIMER, &TIM_OCInitStructure);
+	TIM_OC2Init(LED_TIMER, &TIM_OCInitStructure);
+	TIM_OC3Init(LED_TIMER, &TIM_OCInitStructure);
+	TIM_OC4Init(LED_TIMER, &TIM_OCInitStructure);
+	TIM_OC1PreloadConfig(LED_TIMER, TIM_OCPreload_Enable);
+	TIM_OC2PreloadConfig(LED_TIMER, TIM_OCPreload_Enable);
+	TIM_OC3PreloadConfig(LED_TIMER, TIM_OCPreload_Enable);
+	TIM_OC4PreloadConfig(LED_TIMER, TIM_OCPreload_Enable);
+	TIM_ARRPreloadConfig(LED_TIMER, ENABLE);
+	
+	// Each update event bursts the next row of ledFrames into CCR1-CCR4
+	TIM_DMAConfig(LED_TIMER, TIM_DMABase_CCR1, TIM_DMABurstLength_4Transfers);
+	TIM_DMACmd(LED_TIMER, TIM_DMA_Update, ENABLE);
+}
+
+static void initializeLEDDMA() {
+	DMA_InitTypeDef DMA_InitStructure;
+	
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+	
+	DMA_DeInit(LED_DMA_STREAM);
+	DMA_StructInit(&DMA_InitStructure);
+	DMA_InitStructure.DMA_Channel = LED_DMA_CHANNEL;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&LED_TIMER->DMAR;
+	DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)ledFrames;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+	DMA_InitStructure.DMA_BufferSize = LED_FRAMES * LED_CHANNELS;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_Low;
+	DMA_Init(LED_DMA_STREAM, &DMA_InitStructure);
+	DMA_Cmd(LED_DMA_STREAM, ENABLE);
+}
 
 void initializeLEDs(Led_TypeDef initialLed) {
-	STM_EVAL_LEDInit(LED_GREEN);
-	STM_EVAL_LEDInit(LED_BLUE);
-	STM_EVAL_LEDInit(LED_RED);
-	STM_EVAL_LEDInit(LED_ORANGE);
+	initializeLEDPins();
+	initializeLEDTimer();
+	initializeLEDDMA();
+	TIM_Cmd(LED_TIMER, ENABLE);
 	
 	if(initialLed != (Led_TypeDef) -1)
-		STM_EVAL_LEDOn(initialLed);
+		turnOnLED(initialLed);
 }
 
-void blinkLED(Led_TypeDef led) {
-	STM_EVAL_LEDToggle(led);
+/*
+ * Show a pattern on an LED at brightness percent. Setting the pattern an LED
+ * already shows does nothing.
+ */
+void setLEDPattern(Led_TypeDef led, LedPattern pattern, uint32_t brightness) {
+	uint32_t frame;
+	uint16_t duty;
+	uint8_t channel = LED_CHANNEL[led];
+	
+	if(brightness > LED_FULL_BRIGHTNESS) {
+		brightness = LED_FULL_BRIGHTNESS;
+	}
+	if(pattern == currentPattern[led] && brightness == currentBrightness[led]) {
+		return;
+	}
+	currentPattern[led] = pattern;
+	currentBrightness[led] = brightness;
+	
+	for(frame = 0; frame < LED_FRAMES; frame++) {
+		switch(pattern) {
+			case LED_PATTERN_ON:
+				duty = brightness;
+				break;
+			case LED_PATTERN_BLINK:
+				duty = frame < LED_FRAMES / 2 ? brightness : 0;
+				break;
+			default:
+				duty = 0;
+				break;
+		}
+		ledFrames[frame][channel] = duty;
+	}
 }
 
 void resetAllLEDs() {
-	STM_EVAL_LEDOff(LED_GREEN);
-	STM_EVAL_LEDOff(LED_BLUE);
-	STM_EVAL_LEDOff(LED_RED);
-	STM_EVAL_LEDOff(LED_ORANGE);
+	turnOffLED(LED_GREEN);
+	turnOffLED(LED_BLUE);
+	turnOffLED(LED_RED);
+	turnOffLED(LED_ORANGE);
 }
 
 void turnOnLED(Led_TypeDef led) {
-	STM_EVAL_LEDOn(led);
+	setLEDPattern(led, LED_PATTERN_ON, LED_FULL_BRIGHTNESS);
 }
 
 void turnOffLED(Led_TypeDef led) {
-	STM_EVAL_LEDOff(led);
+	setLEDPattern(led, LED_PATTERN_OFF, 0);
 }
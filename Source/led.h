@@ -3,8 +3,16 @@
 
 #include "discoveryf4utils.h"
 
+#define LED_FULL_BRIGHTNESS 100
+
+typedef enum {
+	LED_PATTERN_OFF,
+	LED_PATTERN_ON,		// steady
+	LED_PATTERN_BLINK	// half a second on, half a second off
+} LedPattern;
+
 void initializeLEDs(Led_TypeDef);
-void blinkLED(Led_TypeDef led);
+void setLEDPattern(Led_TypeDef, LedPattern, uint32_t);
 void resetAllLEDs(void);
 void turnOnLED(Led_TypeDef);
 void turnOffLED(Led_TypeDef);
@@ -17,56 +17,276 @@
 #include "led.h"
 #include "sound.h"
 #include "delay.h"
+#include "input.h"
+#include "stackprofile.h"
+#include "criticalprofile.h"
+#include "job.h"
+#include "priority.h"
+#include "partition.h"
+#include "cyclictable.h"
 //******************************************************************************
 
-#define SAME_START_TIME
-//#define DIFFERENT_START_TIME
-
 #define FIXED_PRIORITY
 //#define EARLIEST_DEADLINE_FIRST
 //#define LEAST_LAXITY_FIRST
+//#define LEAST_LAXITY_FIRST_THRESHOLD
+//#define RATE_MONOTONIC
+//#define DEADLINE_MONOTONIC
+//#define AUDSLEY
+//#define ROUND_ROBIN
+//#define STRIDE
+
+// Only let a job start above the Stack Resource Policy system ceiling, so it is
+// blocked at most once and never preempts a job on its own preemption level.
+// Works with any policy above.
+//#define STACK_RESOURCE_POLICY
+
+// Physical brew heads, one brew worker task each, at most MAX_BREW_HEADS. By default
+// the scheduler hands the BREW_HEADS highest priority jobs to whichever workers are
+// free (global scheduling).
+#define BREW_HEADS 1
+
+// Instead give each Coffee a brew head of its own at start up, first fit decreasing,
+// and schedule each head separately with the policy above. SEMI_PARTITIONED also
+// splits a Coffee that fits on no head whole across two heads.
+//#define PARTITIONED
+//#define SEMI_PARTITIONED
+
+// How one-off orders are served. By default an order is released like one of its
+// Coffee's periodic jobs. A DEFERRABLE_SERVER or SPORADIC_SERVER brews orders for up
+// to serverCapacity ms every SERVER_PERIOD ms, and only in the background once that is
+// used up. Under EARLIEST_DEADLINE_FIRST an order on the budget is scheduled by when
+// the budget comes back, and the budget is the most the started Coffees leave room
+// for. Under the other policies it goes ahead of everything else and the budget is
+// SERVER_BUDGET, which nothing checks. A TOTAL_BANDWIDTH_SERVER, meant for
+// EARLIEST_DEADLINE_FIRST, gives each order the earliest deadline that keeps orders
+// to serverCapacity / SERVER_PERIOD of the machine, the largest share the started
+// Coffees leave room for.
+//#define DEFERRABLE_SERVER
+//#define SPORADIC_SERVER
+//#define TOTAL_BANDWIDTH_SERVER
+#define SERVER_BUDGET 1000
+#define SERVER_PERIOD 10000
+
+// Budget a SPORADIC_SERVER can have waiting to come back, in separate chunks
+#define SPORADIC_REPLENISHMENTS 8
+
+#if defined(DEFERRABLE_SERVER) || defined(SPORADIC_SERVER)
+#define BUDGETED_SERVER
+#endif
+
+// Under EARLIEST_DEADLINE_FIRST, give every Coffee a Constant Bandwidth Server
+// reservation of getReservationBudget ms every getReservationPeriod ms, and schedule it
+// by the reservation's deadline. A Coffee that brews past its budget has its deadline
+// put back a period, so an overrun only makes that Coffee late.
+//#define CONSTANT_BANDWIDTH_SERVER
+
+// Brew from the schedule Tools/cyclic_table_gen.c worked out offline in cyclictable.c
+// instead of working out priorities every pass. Only while every Coffee was started at
+// once and the table was generated for this catalog, otherwise the policy above is used.
+//#define CYCLIC_EXECUTIVE
+
+// Time assignBrews with the DWT cycle counter into maxBrewDispatchCycles and
+// totalBrewDispatchCycles / brewDispatchCount, and each whole scheduler pass into
+// maxPassCycles. Tools/release_sim.c assumes a pass under 600 us (100800 cycles). Leave configCRITICAL_PROFILING off in
+// FreeRTOSConfig.h while timing, or its hooks in xTaskNotifyGive are timed as well.
+//#define DISPATCH_TIMING
+
+// The schedulability test the heads are partitioned with
+#ifdef EARLIEST_DEADLINE_FIRST
+#define HEAD_SCHEDULER HEAD_EARLIEST_DEADLINE_FIRST
+#else
+#define HEAD_SCHEDULER HEAD_RATE_MONOTONIC
+#endif
+
+// Under LEAST_LAXITY_FIRST_THRESHOLD the brewing Coffee is only preempted by one
+// whose laxity is more than this many ms smaller
+#define LAXITY_THRESHOLD 2000
+
+// ms a Coffee gets to brew under ROUND_ROBIN before the next one gets a turn
+#define ROUND_ROBIN_QUANTUM 1000
+
+// Under STRIDE each Coffee's share of brewing is its brew time over its period.
+// Its stride is that share's inverse times this.
+#define STRIDE_SCALE 100
 
 #define STACK_SIZE_MIN	128	/* usStackDepth	- the stack size DEFINED IN WORDS.*/
 
-#define SHORT_PRESS_THRESHOLD 10
-#define LONG_PRESS_THRESHOLD 100
-#define BLINK_TOGGLE 500
+// Per task stack sizes. Build with configSTACK_PROFILING set to 1 in FreeRTOSConfig.h
+// and copy the recommended sizes from stackProfiles[] to right-size these.
+#define STACK_SIZE_WORKER STACK_SIZE_MIN
+#define STACK_SIZE_SCHEDULER STACK_SIZE_MIN
+#define STACK_SIZE_BUTTON STACK_SIZE_MIN
+#define STACK_SIZE_SERIAL STACK_SIZE_MIN
+#define STACK_SIZE_PROFILER STACK_SIZE_MIN
+#define STACK_SIZE_SOUND STACK_SIZE_MIN
+
+// ms of brewing done between updates of a job's remainingWork
+#define BREW_STEP 1
+#define LED_WAITING_BRIGHTNESS 10
 
 // task delays in ms
 #define SOUND_DELAY 100
-#define BUTTON_DELAY 10
 #define SCHEDULER_DELAY 1000
 
-void vButtonUpdate(void *);
-void vBrewCoffeeType(void *);
+// Set a break point at the end of vScheduler to see how many deadlines were missed after this long
+#define RUN_TIME 100000
+
+#define RELEASE_QUEUE_LENGTH 8
+
+#define MAX_PENDING_INPUT 8
+
+void vBrewWorker(void *);
 void vScheduler(void *);
 
 const static Coffee INITIAL_COFFEE = ESPRESSO;
 const static uint32_t PRIORITY_BUTTON = tskIDLE_PRIORITY + 4;
+const static uint32_t PRIORITY_SERIAL = tskIDLE_PRIORITY + 4;
+const static uint32_t PRIORITY_SOUND = tskIDLE_PRIORITY + 4;
 const static uint32_t PRIORITY_BREW = tskIDLE_PRIORITY + 1;
 const static uint32_t PRIORITY_SCHEDULER = tskIDLE_PRIORITY + 3;
+const static uint32_t PRIORITY_PROFILER = tskIDLE_PRIORITY + 2;
+
+static TaskHandle_t xBrewWorkers[BREW_HEADS];
+static volatile Coffee assignedCoffee[BREW_HEADS];	// scheduler: what each worker should brew
+static volatile Coffee workerCoffee[BREW_HEADS];	// worker: what it is brewing this step
+static Coffee brewingCoffee = DEFAULT_COFFEE;	// the last one brewCoffeeType handed to a worker
+static int32_t brewingSince[BREW_HEADS];	// when each worker was handed what it is brewing
+
+/*
+ * What the brew workers and the scheduler tell each other about one Coffee type. Each
+ * field is a single word with a single writer, so neither side can catch it half
+ * written and neither ever has to wait for the other. Only one worker brews a Coffee
+ * at a time, but it doesn't have to be the same one from step to step. The workers
+ * never touch taskTable, which belongs to the scheduler.
+ */
+typedef struct {
+	volatile uint32_t target;		// scheduler: brew until brewed gets this far
+	volatile uint32_t brewed;		// worker: ms brewed so far, over all jobs
+	volatile int32_t finishedAt;	// worker: when brewed last reached target
+} BrewProgress;
+
+static BrewProgress brewProgress[LEDn];
+static uint32_t chargedBrewed[LEDn];	// how much of brewed has been taken off jobs
+
+static uint32_t preemptionLevels[LEDn];
+
+static BrewLoad brewLoads[LEDn];
+static HeadAssignment headAssignments[LEDn];
+uint32_t multiHeadSchedulable = 0;	// whether the Coffees pass the test for the brew heads
+
+/*
+ * Budget a SPORADIC_SERVER gets back at time.
+ */
+typedef struct {
+	int32_t time;
+	int32_t amount;
+} Replenishment;
 
-static xSemaphoreHandle xTaskTableSemaphore;
+static int32_t serverBudget = 0;
+static int32_t serverReplenishedAt = 0;
+static int32_t serverActiveSince = -1;	// when a SPORADIC_SERVER started brewing on the budget it uses now, or -1
+static Replenishment replenishments[SPORADIC_REPLENISHMENTS];
+static uint32_t replenishmentCount = 0;
+static int32_t bandwidthDeadline = 0;	// the deadline of the last order under TOTAL_BANDWIDTH_SERVER
+static int32_t lastPassTime = 0;
+uint32_t serverCapacity = 0;	// ms of budget, or of TOTAL_BANDWIDTH_SERVER share, every SERVER_PERIOD
+static TickType_t nextPassDelay = SCHEDULER_DELAY / portTICK_RATE_MS;	// the longest vScheduler waits for a release
 
-static TaskHandle_t xBrewTasks[LEDn];
-static uint32_t brewCounters[LEDn];
+// One-off orders brewed, and how long they took from being ordered to being done, in ticks
+uint32_t completedOrders = 0;
+uint32_t droppedOrders = 0;
+uint32_t totalOrderResponse = 0;
+uint32_t meanOrderResponse = 0;
+uint32_t maxOrderResponse = 0;
+
+// Each Coffee's CONSTANT_BANDWIDTH_SERVER budget and the deadline it is scheduled by, in ticks
+static int32_t reservationBudget[LEDn];
+static int32_t reservationDeadline[LEDn];
+uint32_t reservationPostponements = 0;	// times a Coffee ran out of budget and was put back a period
+
+uint32_t cyclicTableUsable = 0;	// whether cyclictable.c was generated for this catalog
+
+static int32_t audsleyPriorities[LEDn];
+uint32_t audsleySchedulable = 0;	// whether any fixed priority order meets every deadline
+
+static int32_t stridePass[LEDn];
+static int32_t strideChargedAt = 0;
 
 static Coffee coffees[LEDn] = {LATTE, ESPRESSO, MOCHA, CAPPUCCINO};
 
 uint32_t missedDeadlines = 0;
+uint32_t completedJobs = 0;
+
+// Times a brew was paused part way through for another Coffee
+uint32_t brewSwitches = 0;
+
+// Jobs shed by each Coffee's OverloadPolicy. Aborted jobs also count as missed deadlines.
+uint32_t abortedJobs = 0;
+uint32_t skippedJobs = 0;
+uint32_t degradedJobs = 0;
+
+// RAM the brews take: each Coffee's taskTable entry, release timer and BrewProgress,
+// the job pool, and each worker's TCB, stack and assignment. Only the first part grows
+// with the number of recipes; the pool grows with how many jobs can wait at once.
+uint32_t brewRamBytes = 0;
+
+// Cycles the scheduler spends handing brews to the workers in assignBrews.
+// Only timed under DISPATCH_TIMING.
+uint32_t maxBrewDispatchCycles = 0;
+uint32_t totalBrewDispatchCycles = 0;
+uint32_t brewDispatchCount = 0;
 
+// Longest scheduler pass, from waking up to sleeping again, in cycles.
+// Only timed under DISPATCH_TIMING.
+uint32_t maxPassCycles = 0;
+
+// All times are in kernel ticks (ms)
 typedef struct {
 	int32_t priority;
 	Coffee type;
-	uint32_t scheduled;
-	int32_t deadline;
-	int32_t remainingWork;
+	JobRing jobs;		// released and not yet brewed, the one brewing or next to brew first
 	int32_t started;
 	int32_t startTime;
+	uint32_t releases;	// periods elapsed since startTime, only counted by the release timer once started
 } CoffeeTask;
 
-static CoffeeTask taskTable[LEDn] = {{0, LATTE, 0, 0, 0, 0, 0},{0, ESPRESSO, 0, 0, 0, 0, 0},{0, MOCHA, 0, 0, 0, 0, 0},{0, CAPPUCCINO, 0, 0, 0, 0, 0}};
-static int32_t ticks = 0;
+/*
+ * A periodic Coffee becoming ready to brew, sent from its release timer to the scheduler.
+ */
+typedef struct {
+	Coffee type;
+	int32_t time;
+	int32_t deadline;
+} Release;
+
+static CoffeeTask taskTable[LEDn];
+static JobPool jobPool;		// the jobs all the Coffees' rings are taken from
+
+static TimerHandle_t xReleaseTimers[LEDn];
+static xQueueHandle xReleaseQueue;
+
+// Worst lateness of a release timer callback, in ticks, over releaseCount releases
+uint32_t maxReleaseJitter = 0;
+uint32_t releaseCount = 0;
+
+static InputEvent pendingInput[MAX_PENDING_INPUT];
+static uint32_t pendingInputCount = 0;
+
+void vReleaseTimerCallback(TimerHandle_t);
+void startCoffeeType(Coffee);
+void startAllCoffees(void);
+void orderCoffee(Coffee, uint32_t);
+void selectNextCoffee(void);
+uint32_t tableMatchesCatalog(void);
+void sizeServer(void);
+
+/*
+ * The kernel tick count, the time base for every start time and deadline.
+ */
+static int32_t currentTime() {
+	return (int32_t)xTaskGetTickCount();
+}
 
 //******************************************************************************
 int main(void) {
@@ -84,30 +304,88 @@ int main(void) {
 		NVIC_PriorityGroupConfig( NVIC_PriorityGroup_4 ); before the RTOS is started.
 	*/
 	int32_t i;
+	TaskHandle_t xHandle;
 	
 	NVIC_PriorityGroupConfig( NVIC_PriorityGroup_4 );
+	initializeCriticalProfiler();
+#ifdef DISPATCH_TIMING
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
 	
 	// Initializations
-	STM_EVAL_PBInit(BUTTON_USER, BUTTON_MODE_GPIO);
+	initializeInput();
 	initializeCoffee(INITIAL_COFFEE);
 	initializeLEDs((Led_TypeDef) -1);
 	initializeSound();
 	TM_Delay_Init();
+#ifdef CYCLIC_EXECUTIVE
+	cyclicTableUsable = tableMatchesCatalog();
+#endif
+	
+	for(i = 0; i < LEDn; i++) {
+		brewLoads[i].work = getBrewDurations(coffees[i]);
+		brewLoads[i].deadline = getCoffeeDeadline(coffees[i]);
+		brewLoads[i].period = getCoffeePeriod(coffees[i]);
+		headAssignments[i].head = NO_HEAD;
+		headAssignments[i].splitHead = NO_HEAD;
+	}
+	audsleySchedulable = assignAudsleyPriorities(brewLoads, LEDn, audsleyPriorities);
+#ifdef STACK_RESOURCE_POLICY
+	assignPreemptionLevels(brewLoads, LEDn, preemptionLevels);
+#endif
+#if defined(SEMI_PARTITIONED)
+	multiHeadSchedulable = partitionLoads(brewLoads, LEDn, BREW_HEADS, HEAD_SCHEDULER, 1, headAssignments);
+#elif defined(PARTITIONED)
+	multiHeadSchedulable = partitionLoads(brewLoads, LEDn, BREW_HEADS, HEAD_SCHEDULER, 0, headAssignments);
+#else
+	multiHeadSchedulable = globalEdfSchedulable(brewLoads, LEDn, BREW_HEADS);
+#endif
+	sizeServer();
 	
-	xTaskTableSemaphore = xSemaphoreCreateBinary();
-	xSemaphoreGive(xTaskTableSemaphore);
+	xReleaseQueue = xQueueCreate(RELEASE_QUEUE_LENGTH, sizeof(Release));
 	
-	// Create a brew task and semaphore for each Coffee type
+	// Create a release timer for each Coffee type
+	initJobPool(&jobPool);
 	for(i = 0; i < LEDn; i++) {
-		xTaskCreate( vBrewCoffeeType, (const char*)"Brew Type", 
-			STACK_SIZE_MIN, (void *)&coffees[i], PRIORITY_BREW, &xBrewTasks[i]);
-		vTaskSuspend(xBrewTasks[i]);
+		taskTable[i].type = coffees[i];
+		initJobRing(&taskTable[i].jobs, &jobPool);
+		
+		xReleaseTimers[i] = xTimerCreate((const char*)"Release", 
+			getCoffeePeriod(coffees[i]) / portTICK_RATE_MS, pdTRUE, (void *)coffees[i], vReleaseTimerCallback);
 	}
 	
+	// and a brew worker for each brew head
+	for(i = 0; i < BREW_HEADS; i++) {
+		assignedCoffee[i] = DEFAULT_COFFEE;
+		workerCoffee[i] = DEFAULT_COFFEE;
+		xTaskCreate( vBrewWorker, (const char*)"Brew", 
+			STACK_SIZE_WORKER, (void *)i, PRIORITY_BREW, &xBrewWorkers[i]);
+		profileTaskStack(xBrewWorkers[i], STACK_SIZE_WORKER);
+	}
+	brewRamBytes = LEDn * (sizeof(CoffeeTask) + sizeof(StaticTimer_t) + sizeof(BrewProgress) + sizeof(chargedBrewed[0])) + sizeof(jobPool) + 
+		BREW_HEADS * (sizeof(StaticTask_t) + STACK_SIZE_WORKER * sizeof(StackType_t) + 
+		sizeof(assignedCoffee[0]) + sizeof(workerCoffee[0]));
+	
 	xTaskCreate( vScheduler, (const char*)"Scheduler", 
-		STACK_SIZE_MIN, NULL, PRIORITY_SCHEDULER, NULL );
-	xTaskCreate( vButtonUpdate, (const char*)"Button Update", 
-		STACK_SIZE_MIN, NULL, PRIORITY_BUTTON, NULL );
+		STACK_SIZE_SCHEDULER, NULL, PRIORITY_SCHEDULER, &xHandle );
+	profileTaskStack(xHandle, STACK_SIZE_SCHEDULER);
+	xTaskCreate( vButtonGestures, (const char*)"Button", 
+		STACK_SIZE_BUTTON, NULL, PRIORITY_BUTTON, &xHandle );
+	profileTaskStack(xHandle, STACK_SIZE_BUTTON);
+	xTaskCreate( vSerialCommands, (const char*)"Serial", 
+		STACK_SIZE_SERIAL, NULL, PRIORITY_SERIAL, &xHandle );
+	profileTaskStack(xHandle, STACK_SIZE_SERIAL);
+	xTaskCreate( vSoundService, (const char*)"Sound", 
+		STACK_SIZE_SOUND, NULL, PRIORITY_SOUND, &xHandle );
+	profileTaskStack(xHandle, STACK_SIZE_SOUND);
+	
+#if configSTACK_PROFILING == 1
+	xTaskCreate( vStackProfiler, (const char*)"Stack Prof", 
+		STACK_SIZE_PROFILER, NULL, PRIORITY_PROFILER, &xHandle );
+	profileTaskStack(xHandle, STACK_SIZE_PROFILER);
+#endif
 	vTaskStartScheduler();
 	
 	// Should not reach here
@@ -125,8 +403,25 @@ void schedule_FixedPriority(Coffee *scheduled, uint32_t scheduledCount) {
 	}
 }
 
+/*
+ * The deadline EDF schedules a Coffee type's oldest job by: its own, or its Coffee's
+ * reservation's under CONSTANT_BANDWIDTH_SERVER.
+ */
+int32_t getSchedulingDeadline(Coffee type) {
+	Job *job = peekJob(&taskTable[type].jobs);
+	
+#ifdef CONSTANT_BANDWIDTH_SERVER
+	if(!job->aperiodic) {
+		return reservationDeadline[type];
+	}
+#endif
+	return job->deadline;
+}
+
 /* 
  * Set priorities in the taskTable using an earliest deadline first algorithm.
+ * A type's jobs share one relative deadline and brew in release order, so its oldest
+ * job always has its earliest deadline and ordering types by it orders the jobs.
  */ 
 void schedule_EarliestDeadlineFirst(Coffee *scheduled, uint32_t scheduledCount) {
 	int32_t i;
@@ -134,7 +429,7 @@ void schedule_EarliestDeadlineFirst(Coffee *scheduled, uint32_t scheduledCount)
 	for(i = 0; i < scheduledCount; i++) {
 		// Make this negative so that the numerically smallest (aka earliest) deadline gets
 		// picked by getHighestPriorityTask
-		taskTable[scheduled[i]].priority = -(taskTable[scheduled[i]].deadline);
+		taskTable[scheduled[i]].priority = -getSchedulingDeadline(scheduled[i]);
 	}
 }
 
@@ -143,27 +438,280 @@ void schedule_EarliestDeadlineFirst(Coffee *scheduled, uint32_t scheduledCount)
  */ 
 void schedule_LeastLaxityFirst(Coffee *scheduled, uint32_t scheduledCount) {
 	int32_t i;
+	Job *job;
 	
 	for(i = 0; i < scheduledCount; i++) {
+		job = peekJob(&taskTable[scheduled[i]].jobs);
 		// Make this negative so that the numerically smallest laxity gets
 		// picked by getHighestPriorityTask
-		taskTable[scheduled[i]].priority = -(taskTable[scheduled[i]].deadline - taskTable[scheduled[i]].remainingWork);
+		taskTable[scheduled[i]].priority = -(job->deadline - job->remainingWork);
+	}
+}
+
+
+/*
+ * The worker a Coffee type's oldest job is handed to, or BREW_HEADS if it isn't.
+ */
+uint32_t getWorker(Coffee type) {
+	uint32_t i;
+	
+	for(i = 0; i < BREW_HEADS; i++) {
+		if(type != DEFAULT_COFFEE && assignedCoffee[i] == type) {
+			return i;
+		}
+	}
+	return BREW_HEADS;
+}
+
+/*
+ * Whether a Coffee type is brewing right now, as opposed to finished or paused.
+ */
+uint32_t isBrewing(Coffee type) {
+	return getWorker(type) < BREW_HEADS;
+}
+
+/*
+ * The brew head a Coffee type's oldest job has to brew on, or BREW_HEADS if any will do.
+ * A split job moves to its second head once it has brewed its first part.
+ */
+uint32_t getCoffeeHead(Coffee type) {
+#if defined(PARTITIONED) || defined(SEMI_PARTITIONED)
+	Job *job = peekJob(&taskTable[type].jobs);
+	
+	if(headAssignments[type].splitHead != NO_HEAD && job != NULL && 
+			(int32_t)(getBrewDurations(type) / portTICK_RATE_MS) - job->remainingWork >= (int32_t)headAssignments[type].splitWork) {
+		return headAssignments[type].splitHead;
+	}
+	return headAssignments[type].head;
+#else
+	return BREW_HEADS;
+#endif
+}
+
+/*
+ * Whether a Coffee type's oldest job is split and still brewing its first part.
+ */
+uint32_t isFirstPart(Coffee type) {
+	return headAssignments[type].splitHead != NO_HEAD && getCoffeeHead(type) == headAssignments[type].head;
+}
+
+/*
+ * Under SEMI_PARTITIONED the first part of a split job has no slack to spare, so it goes
+ * ahead of everything else on its head whatever the policy.
+ */
+void prioritiseFirstParts(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t i;
+	
+	for(i = 0; i < scheduledCount; i++) {
+		if(isFirstPart(scheduled[i])) {
+			taskTable[scheduled[i]].priority = 0x7FFFFFFF;
+		}
+	}
+}
+
+/*
+ * The Coffee types whose oldest job has to brew on some other head than this one.
+ */
+uint32_t getOtherHeadsMask(uint32_t head) {
+	uint32_t mask = 0;
+	uint32_t coffeeHead;
+	int32_t i;
+	
+	for(i = 0; i < LEDn; i++) {
+		coffeeHead = getCoffeeHead(coffees[i]);
+		if(coffeeHead != BREW_HEADS && coffeeHead != head) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+}
+
+/*
+ * The Coffee types whose oldest job is an order that hasn't started and couldn't
+ * finish before its Coffee is next released. A periodic job can't overtake an order
+ * once it has started, so it waits for the release instead.
+ */
+uint32_t getHeldOrdersMask(int32_t now) {
+	uint32_t mask = 0;
+	int32_t nextRelease;
+	Job *job;
+	int32_t i;
+	
+	for(i = 0; i < LEDn; i++) {
+		job = peekJob(&taskTable[i].jobs);
+		if(job == NULL || !job->aperiodic || job->startTime != JOB_NOT_STARTED || !taskTable[i].started) {
+			continue;
+		}
+		nextRelease = taskTable[i].startTime + (taskTable[i].releases + 1) * (getCoffeePeriod(coffees[i]) / portTICK_RATE_MS);
+		if(now + job->remainingWork > nextRelease) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+}
+
+/* 
+ * Set priorities in the taskTable using least laxity first, except that the Coffee
+ * that is brewing keeps going unless another one's laxity is more than
+ * LAXITY_THRESHOLD smaller. Plain LLF swaps two brews back and forth every pass
+ * when their laxities are close.
+ */ 
+void schedule_LeastLaxityFirstThreshold(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t i;
+	
+	schedule_LeastLaxityFirst(scheduled, scheduledCount);
+	for(i = 0; i < scheduledCount; i++) {
+		if(isBrewing(scheduled[i])) {
+			taskTable[scheduled[i]].priority += LAXITY_THRESHOLD / portTICK_RATE_MS;
+		}
+	}
+}
+
+/* 
+ * Set priorities in the taskTable by rate monotonic: the shorter a Coffee's period the higher its priority.
+ */ 
+void schedule_RateMonotonic(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t i;
+	
+	for(i = 0; i < scheduledCount; i++) {
+		taskTable[scheduled[i]].priority = -(int32_t)getCoffeePeriod(scheduled[i]);
+	}
+}
+
+/* 
+ * Set priorities in the taskTable by deadline monotonic: the shorter a Coffee's relative
+ * deadline the higher its priority.
+ */ 
+void schedule_DeadlineMonotonic(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t i;
+	
+	for(i = 0; i < scheduledCount; i++) {
+		taskTable[scheduled[i]].priority = -(int32_t)getCoffeeDeadline(scheduled[i]);
+	}
+}
+
+/* 
+ * Set priorities in the taskTable from Audsley's optimal priority assignment, worked
+ * out once at start up.
+ */ 
+void schedule_Audsley(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t i;
+	
+	for(i = 0; i < scheduledCount; i++) {
+		taskTable[scheduled[i]].priority = audsleyPriorities[scheduled[i]];
+	}
+}
+
+/* 
+ * Set priorities in the taskTable so that Coffees take turns brewing for
+ * ROUND_ROBIN_QUANTUM each, in Coffee order starting after the last one to brew.
+ * Each brewing Coffee's turn is timed from when its own worker was handed it.
+ */ 
+void schedule_RoundRobin(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t i;
+	
+	for(i = 0; i < scheduledCount; i++) {
+		if(isBrewing(scheduled[i]) && 
+				currentTime() - brewingSince[getWorker(scheduled[i])] < ROUND_ROBIN_QUANTUM / portTICK_RATE_MS) {
+			taskTable[scheduled[i]].priority = 1;
+		} else {
+			taskTable[scheduled[i]].priority = -(((int32_t)scheduled[i] + 2 * LEDn - (int32_t)brewingCoffee - 1) % LEDn);
+		}
+	}
+}
+
+/*
+ * How far a Coffee's pass moves per ms it brews under STRIDE.
+ */
+int32_t getStride(Coffee type) {
+	return STRIDE_SCALE * getCoffeePeriod(type) / getBrewDurations(type);
+}
+
+/* 
+ * Set priorities in the taskTable by stride scheduling. Each Coffee's pass moves on
+ * by its stride for every ms it brews and the smallest pass goes next, so over time
+ * each Coffee brews in proportion to its share.
+ */ 
+void schedule_Stride(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t now = currentTime();
+	int32_t minPass = 0x7FFFFFFF;
+	int32_t i;
+	
+	for(i = 0; i < LEDn; i++) {
+		if(isBrewing(coffees[i])) {
+			stridePass[i] += getStride(coffees[i]) * (now - strideChargedAt);
+		}
+	}
+	strideChargedAt = now;
+	
+	if(scheduledCount == 0) {
+		return;
+	}
+	
+	// Keep the passes small. A Coffee that had nothing to brew comes back at the
+	// smallest pass instead of with the credit it built up while it was idle.
+	for(i = 0; i < scheduledCount; i++) {
+		if(stridePass[scheduled[i]] < minPass) {
+			minPass = stridePass[scheduled[i]];
+		}
+	}
+	for(i = 0; i < LEDn; i++) {
+		stridePass[i] -= minPass;
+		if(stridePass[i] < 0) {
+			stridePass[i] = 0;
+		}
+	}
+	
+	for(i = 0; i < scheduledCount; i++) {
+		taskTable[scheduled[i]].priority = -stridePass[scheduled[i]];
+	}
+}
+
+/*
+ * The Stack Resource Policy system ceiling: the highest preemption level with a job
+ * that has started and not finished. -1 if there is none.
+ */
+int32_t getSystemCeiling() {
+	int32_t ceiling = -1;
+	int32_t i;
+	Job *job;
+	
+	for(i = 0; i < LEDn; i++) {
+		job = peekJob(&taskTable[i].jobs);
+		if(job != NULL && job->startTime != JOB_NOT_STARTED && (int32_t)preemptionLevels[i] > ceiling) {
+			ceiling = preemptionLevels[i];
+		}
 	}
+	return ceiling;
 }
 
+/*
+ * Whether a Coffee type's oldest job may brew. Under STACK_RESOURCE_POLICY a job that
+ * hasn't started can only start above the system ceiling. So it is blocked at most once,
+ * before it starts, and never preempts a started job on its own level.
+ */
+uint32_t mayBrew(Coffee type, int32_t ceiling) {
+#ifdef STACK_RESOURCE_POLICY
+	return peekJob(&taskTable[type].jobs)->startTime != JOB_NOT_STARTED || (int32_t)preemptionLevels[type] > ceiling;
+#else
+	return 1;
+#endif
+}
 
 /* 
- * Retrieve the highest priority task from the taskTable.
+ * Retrieve the highest priority task from the taskTable, leaving out the Coffee types
+ * in the skipped bit mask.
  * Note that this is a different priority than the ones we're given in the assignment.
  * This priority is calculated based on the scheduling algorithm.
  */
-Coffee getHighestPriorityTask() {
+Coffee getHighestPriorityTask(uint32_t skipped) {
 	int32_t i;
 	Coffee selectedTypeToBrew = DEFAULT_COFFEE;
 	int32_t maxPriority = 0x80000000; // Set to minimum 32 bit int
+	int32_t ceiling = getSystemCeiling();
 	
 	for(i = 0; i < LEDn; i++) {
-		if(taskTable[i].scheduled > 0 && 
+		if(taskTable[i].jobs.count > 0 && !(skipped & (1 << i)) && mayBrew(taskTable[i].type, ceiling) && 
 				(taskTable[i].priority > maxPriority || 
 				(taskTable[i].priority == maxPriority && getCoffeePriority(taskTable[i].type) > getCoffeePriority(selectedTypeToBrew)))) {
 			maxPriority = taskTable[i].priority;
@@ -175,144 +723,922 @@ Coffee getHighestPriorityTask() {
 }
 
 /*
- * Pause all brews. Note that this does not "complete" any brews
- * since we don't reset any counters and we don't play sound.
+ * Take a Coffee type's job off its worker. This does not "complete" the brew since
+ * we don't reset any counters and we don't play sound. The worker notices within a
+ * BREW_STEP, and whatever it had brewed stays with the job.
+ */
+void stopBrew(Coffee coffee) {
+	uint32_t worker = getWorker(coffee);
+	
+	if(worker < BREW_HEADS) {
+		assignedCoffee[worker] = DEFAULT_COFFEE;
+	}
+}
+
+/*
+ * A Coffee's CONSTANT_BANDWIDTH_SERVER wakes up for a job released at now with nothing
+ * else waiting. It keeps its deadline and what is left of its budget unless that would
+ * brew faster than the reservation allows, and otherwise starts over with a full budget
+ * and the job's deadline.
+ */
+void wakeReservation(Coffee type, int32_t now, int32_t deadline) {
+#ifdef CONSTANT_BANDWIDTH_SERVER
+	int32_t budget = getReservationBudget(type) / portTICK_RATE_MS;
+	int32_t period = getReservationPeriod(type) / portTICK_RATE_MS;
+	
+	if((int64_t)reservationBudget[type] * period >= (int64_t)(reservationDeadline[type] - now) * budget) {
+		reservationBudget[type] = budget;
+		reservationDeadline[type] = deadline;
+	}
+#endif
+}
+
+/*
+ * Take what a Coffee brewed since the last pass off its CONSTANT_BANDWIDTH_SERVER budget.
+ * Every time the budget runs out with brewing still to do, it is refilled and the
+ * deadline put back a period.
+ */
+void chargeReservation(Coffee type, int32_t used) {
+#ifdef CONSTANT_BANDWIDTH_SERVER
+	int32_t budget = getReservationBudget(type) / portTICK_RATE_MS;
+	int32_t period = getReservationPeriod(type) / portTICK_RATE_MS;
+	
+	reservationBudget[type] -= used;
+	while(reservationBudget[type] < 0 || (reservationBudget[type] == 0 && taskTable[type].jobs.count > 0)) {
+		reservationBudget[type] += budget;
+		reservationDeadline[type] += period;
+		reservationPostponements++;
+	}
+#endif
+}
+
+/*
+ * Whether cyclictable.c was generated for the catalog in coffee.c and one brew head.
+ */
+uint32_t tableMatchesCatalog() {
+	int32_t i;
+	
+	if(cyclicCatalogSize != LEDn || BREW_HEADS != 1) {
+		return 0;
+	}
+	for(i = 0; i < LEDn; i++) {
+		if(cyclicCatalog[i].work != getBrewDurations(coffees[i]) + getBrewOverrun(coffees[i]) ||
+				cyclicCatalog[i].period != getCoffeePeriod(coffees[i]) ||
+				cyclicCatalog[i].deadline != getCoffeeDeadline(coffees[i])) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Whether cyclictable.c has given a Coffee's periodic job every slot its brew takes,
+ * before slot current.
+ */
+uint32_t hadItsSlots(Coffee type, Job *job, int32_t current) {
+	int32_t start = taskTable[0].startTime;
+	int32_t slot = CYCLIC_SLOT / portTICK_RATE_MS;
+	uint32_t given = 0;
+	int32_t i;
+	
+	for(i = (job->release - start + slot / 2) / slot; i < current; i++) {
+		if(cyclicTable[i % cyclicTableSize] == type) {
+			given++;
+		}
+	}
+	return given * CYCLIC_SLOT >= cyclicCatalog[type].work;
+}
+
+/*
+ * Under CYCLIC_EXECUTIVE look up the Coffee to brew now, or DEFAULT_COFFEE to brew
+ * nothing, in the table. Returns 0 if the table doesn't apply and the policy has to
+ * choose: it wasn't generated for this catalog, the Coffees weren't all started at
+ * once, the Coffee it names has nothing to brew, or the slot is idle but something
+ * is waiting.
+ */
+uint32_t dispatchFromTable(int32_t now, Coffee *coffee) {
+#ifdef CYCLIC_EXECUTIVE
+	int32_t start = taskTable[0].startTime;
+	int32_t slot = CYCLIC_SLOT / portTICK_RATE_MS;
+	int32_t current;
+	Job *overrun = NULL;
+	Job *job;
+	int32_t i;
+	
+	if(!cyclicTableUsable) {
+		return 0;
+	}
+	for(i = 0; i < LEDn; i++) {
+		// startAllCoffees can straddle a tick
+		if(!taskTable[i].started || taskTable[i].startTime - start > 1 || start - taskTable[i].startTime > 1) {
+			return 0;
+		}
+	}
+	
+	// Passes come on slot boundaries give or take a tick, so go by the nearest one
+	current = (now - start + slot / 2) / slot;
+	
+	// TM_DelayMillis doesn't count the time the worker is preempted, so a job is still
+	// brewing a few ms after the last of its slots. Finish it first and pass again once
+	// it should be done, or the rest of it would wait for its Coffee's next turn.
+	for(i = 0; i < LEDn; i++) {
+		job = peekJob(&taskTable[i].jobs);
+		if(job != NULL && !job->aperiodic && job->startTime != JOB_NOT_STARTED && 
+				hadItsSlots(coffees[i], job, current) && (overrun == NULL || job->deadline < overrun->deadline)) {
+			overrun = job;
+			*coffee = coffees[i];
+		}
+	}
+	if(overrun != NULL) {
+		if((TickType_t)overrun->remainingWork + 1 < nextPassDelay) {
+			nextPassDelay = (TickType_t)overrun->remainingWork + 1;
+		}
+		return 1;
+	}
+	
+	*coffee = (Coffee)cyclicTable[current % cyclicTableSize];
+	if(*coffee != DEFAULT_COFFEE) {
+		return taskTable[*coffee].jobs.count > 0;
+	}
+	
+	// An idle slot only stays idle while nothing is waiting
+	for(i = 0; i < LEDn; i++) {
+		if(taskTable[i].jobs.count > 0) {
+			return 0;
+		}
+	}
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Work out serverCapacity for the Coffees started so far. Under EARLIEST_DEADLINE_FIRST
+ * it is the most partition.c's demand test lets the server have next to them, released
+ * when they were started, and 0 if even their own jobs can miss. The budget moves by
+ * as much as the capacity does.
+ */
+void sizeServer() {
+#if defined(BUDGETED_SERVER) || defined(TOTAL_BANDWIDTH_SERVER)
+	uint32_t capacity = SERVER_BUDGET;
+#ifdef EARLIEST_DEADLINE_FIRST
+	BrewLoad loads[LEDn];
+	uint32_t phases[LEDn];
+	int32_t first = 0;
+	uint32_t count = 0;
+	int32_t i;
+	
+	for(i = 0; i < LEDn; i++) {
+		if(taskTable[i].started && (count == 0 || taskTable[i].startTime < first)) {
+			first = taskTable[i].startTime;
+		}
+		if(taskTable[i].started) {
+			count++;
+		}
+	}
+	count = 0;
+	for(i = 0; i < LEDn; i++) {
+		if(taskTable[i].started) {
+			loads[count] = brewLoads[i];
+			phases[count] = (taskTable[i].startTime - first) * portTICK_RATE_MS;
+			count++;
+		}
+	}
+#if defined(TOTAL_BANDWIDTH_SERVER)
+	capacity = getServerBudget(loads, phases, count, SERVER_PERIOD, SERVER_TOTAL_BANDWIDTH);
+#elif defined(SPORADIC_SERVER)
+	capacity = getServerBudget(loads, phases, count, SERVER_PERIOD, SERVER_SPORADIC);
+#else
+	capacity = getServerBudget(loads, phases, count, SERVER_PERIOD, SERVER_DEFERRABLE);
+#endif
+#endif
+	
+	serverBudget += ((int32_t)capacity - (int32_t)serverCapacity) / portTICK_RATE_MS;
+	serverCapacity = capacity;
+#endif
+}
+
+/*
+ * Give the server back the budget that has come due: all of it every SERVER_PERIOD for
+ * a DEFERRABLE_SERVER, and each chunk SERVER_PERIOD after the server became active
+ * to spend it for a SPORADIC_SERVER, never more than serverCapacity.
+ */
+void replenishServer(int32_t now) {
+#if defined(DEFERRABLE_SERVER)
+	if(now - serverReplenishedAt >= SERVER_PERIOD / portTICK_RATE_MS) {
+		serverReplenishedAt = now - (now - serverReplenishedAt) % (SERVER_PERIOD / portTICK_RATE_MS);
+		serverBudget = serverCapacity / portTICK_RATE_MS;
+	}
+#elif defined(SPORADIC_SERVER)
+	uint32_t kept = 0;
+	uint32_t i;
+	
+	for(i = 0; i < replenishmentCount; i++) {
+		if(replenishments[i].time <= now) {
+			serverBudget += replenishments[i].amount;
+		} else {
+			replenishments[kept++] = replenishments[i];
+		}
+	}
+	replenishmentCount = kept;
+	
+	// Chunks used before a Coffee started can bring back more than is left for the server now
+	if(serverBudget > (int32_t)(serverCapacity / portTICK_RATE_MS)) {
+		serverBudget = serverCapacity / portTICK_RATE_MS;
+	}
+#endif
+}
+
+/*
+ * Take what an order brewed since the last pass off the server's budget. Brewing it did
+ * in the background, with no budget left, is free.
+ */
+void chargeServer(int32_t used) {
+#ifdef SPORADIC_SERVER
+	int32_t time;
+	
+#endif
+	if(used > serverBudget) {
+		used = serverBudget;
+	}
+	if(used <= 0) {
+		return;
+	}
+	serverBudget -= used;
+	
+#ifdef SPORADIC_SERVER
+	// Everything used since the server started brewing comes back together, a period
+	// after it started
+	time = (serverActiveSince >= 0 ? serverActiveSince : lastPassTime) + SERVER_PERIOD / portTICK_RATE_MS;
+	
+	// and when out of room the latest chunk comes back later instead, never sooner
+	if(replenishmentCount > 0 && (replenishmentCount == SPORADIC_REPLENISHMENTS ||
+			replenishments[replenishmentCount - 1].time == time)) {
+		replenishments[replenishmentCount - 1].time = time;
+		replenishments[replenishmentCount - 1].amount += used;
+		return;
+	}
+	replenishments[replenishmentCount].time = time;
+	replenishments[replenishmentCount].amount = used;
+	replenishmentCount++;
+#endif
+}
+
+/*
+ * Pass again as soon as the first of the jobs on the workers should be done, or its
+ * head would sit idle until the next release or SCHEDULER_DELAY. A worker that was
+ * preempted on the way isn't quite done by then, and the next pass just comes back
+ * for the few ms it has left.
+ */
+void passWhenBrewsEnd() {
+	Coffee coffee;
+	uint32_t remaining;
+	uint32_t i;
+	
+	for(i = 0; i < BREW_HEADS; i++) {
+		coffee = assignedCoffee[i];
+		if(coffee == DEFAULT_COFFEE) {
+			continue;
+		}
+		remaining = brewProgress[coffee].brewed < brewProgress[coffee].target ?
+				brewProgress[coffee].target - brewProgress[coffee].brewed : 0;
+		if((TickType_t)remaining + 1 < nextPassDelay) {
+			nextPassDelay = (TickType_t)remaining + 1;
+		}
+	}
+}
+
+/*
+ * A SPORADIC_SERVER is active from the pass that hands an order its budget until the
+ * pass that finds no order brewing on the budget any more.
  */
-void pauseAllBrews() {
+void trackServerActivity(int32_t now) {
+#ifdef SPORADIC_SERVER
+	uint32_t active = 0;
+	Job *job;
 	int32_t i;
+	
 	for(i = 0; i < LEDn; i++) {
-		vTaskSuspend(xBrewTasks[i]);
+		job = peekJob(&taskTable[i].jobs);
+		if(job != NULL && job->aperiodic && isBrewing(coffees[i])) {
+			active = 1;
+		}
+	}
+	if(!active || serverBudget <= 0) {
+		serverActiveSince = -1;
+	} else if(serverActiveSince < 0) {
+		serverActiveSince = now;
+	}
+#endif
+}
+
+/*
+ * Under DEFERRABLE_SERVER or SPORADIC_SERVER an order is scheduled on the server's
+ * budget while it has some, and behind every periodic job once it hasn't. Under
+ * EARLIEST_DEADLINE_FIRST the budget's deadline is when it comes back, the end of
+ * the period for a DEFERRABLE_SERVER and a period after it became active for a
+ * SPORADIC_SERVER. It stays put for as long as the server uses that budget, which is
+ * what partition.c's demand test assumes.
+ * Otherwise the budget goes ahead of every periodic job.
+ * A periodic job can't overtake an order that has started brewing, so such an order
+ * brews at no less than the priority the periodic job behind it would get, and by a
+ * deadline that leaves that job its work.
+ */
+void prioritiseOrders(Coffee *scheduled, uint32_t scheduledCount) {
+	int32_t inherited;
+	int32_t i;
+	Job *job;
+	Job *next;
+	
+	for(i = 0; i < scheduledCount; i++) {
+		job = peekJob(&taskTable[scheduled[i]].jobs);
+		if(!job->aperiodic) {
+			continue;
+		}
+		inherited = taskTable[scheduled[i]].priority;
+#ifdef BUDGETED_SERVER
+		if(serverBudget <= 0) {
+			taskTable[scheduled[i]].priority = 0x80000001;
+		} else {
+#if defined(EARLIEST_DEADLINE_FIRST) && defined(DEFERRABLE_SERVER)
+			taskTable[scheduled[i]].priority = -(serverReplenishedAt + SERVER_PERIOD / portTICK_RATE_MS);
+#elif defined(EARLIEST_DEADLINE_FIRST)
+			taskTable[scheduled[i]].priority = -((serverActiveSince >= 0 ? serverActiveSince : currentTime()) +
+					SERVER_PERIOD / portTICK_RATE_MS);
+#else
+			taskTable[scheduled[i]].priority = 0x7FFFFFFE;
+#endif
+		}
+#endif
+		
+		next = peekNextJob(&taskTable[scheduled[i]].jobs);
+		if(job->startTime != JOB_NOT_STARTED && next != NULL && !next->aperiodic) {
+#if defined(EARLIEST_DEADLINE_FIRST)
+			inherited = -(next->deadline - next->remainingWork);
+#elif defined(LEAST_LAXITY_FIRST) || defined(LEAST_LAXITY_FIRST_THRESHOLD)
+			inherited = -(next->deadline - next->remainingWork - job->remainingWork);
+#endif
+			if(inherited > taskTable[scheduled[i]].priority) {
+				taskTable[scheduled[i]].priority = inherited;
+			}
+		}
+	}
+}
+
+/*
+ * Point a Coffee type's worker at the end of its oldest job, or at nothing.
+ */
+void setBrewTarget(Coffee coffee) {
+	Job *job = peekJob(&taskTable[coffee].jobs);
+	int32_t work = job != NULL && job->remainingWork > 0 ? job->remainingWork : 0;
+	
+	// The first part of a split job stops where the job moves to its other head
+	if(work > 0 && isFirstPart(coffee)) {
+		work -= getBrewDurations(coffee) / portTICK_RATE_MS - headAssignments[coffee].splitWork;
+	}
+#ifdef BUDGETED_SERVER
+	// and an order brewing on the server's budget stops where the budget runs out
+	if(job != NULL && job->aperiodic && serverBudget > 0 && work > serverBudget) {
+		work = serverBudget;
 	}
+#endif
+	brewProgress[coffee].target = chargedBrewed[coffee] + work;
 }
 
 /*
- * Stop brewing a Coffee type and play a sound to alert the user.
+ * Finish a Coffee type's oldest job and play a sound to alert the user.
  */
-void endBrew(Coffee coffee) {
-	// clean up
-	brewCounters[coffee] = 0;
-	taskTable[coffee].scheduled--;
+void endBrew(Coffee coffee, int32_t finishedAt) {
+	Job *job = peekJob(&taskTable[coffee].jobs);
+	uint32_t response = (uint32_t)(finishedAt - job->release);
+	
+	stopBrew(coffee);
 	
-	if(ticks > taskTable[coffee].deadline) {
+	if(job->aperiodic) {
+		completedOrders++;
+		totalOrderResponse += response;
+		meanOrderResponse = totalOrderResponse / completedOrders;
+		if(response > maxOrderResponse) {
+			maxOrderResponse = response;
+		}
+	} else if(finishedAt > job->deadline) {
 		missedDeadlines++;
 	}
+	popJob(&taskTable[coffee].jobs);
+	completedJobs++;
+	setBrewTarget(coffee);
 	
 	turnOffLED(getLEDForCoffeeType(coffee));
 	
 	// play sound
-	prepareSound();
-	playSound();
+	playSound(coffee);
+}
+
+/*
+ * Take what the workers have brewed of each Coffee type since the last pass off its
+ * oldest job and finish the jobs that are done.
+ */
+void collectBrewProgress() {
+	int32_t i;
+	uint32_t brewed;
+	int32_t used;
+	uint32_t reserved;
+	Job *job;
 	
-	// prevent task from running
-	vTaskSuspend(xBrewTasks[coffee]);
+	for(i = 0; i < LEDn; i++) {
+		brewed = brewProgress[i].brewed;
+		job = peekJob(&taskTable[i].jobs);
+		if(job == NULL) {
+			chargedBrewed[i] = brewed;
+			continue;
+		}
+		
+		used = (int32_t)(brewed - chargedBrewed[i]);
+		reserved = !job->aperiodic;
+		if(job->aperiodic) {
+			chargeServer(used);
+		}
+		job->remainingWork -= used;
+		chargedBrewed[i] = brewed;
+		if(job->remainingWork <= 0) {
+			endBrew(coffees[i], brewProgress[i].finishedAt);
+		}
+		if(reserved && used > 0) {
+			chargeReservation(coffees[i], used);
+		}
+	}
 }
 
 /*
- * Brews a Coffee type, blinking the corresponding LED to indicate progress.
+ * Brews whatever job the scheduler has handed this worker, one BREW_STEP at a time.
  * We use TM_DelayMillis here as a "busy wait" function. We need to give this
- * task something to do so that the CPU doesn't just preempt to the next task
- * after toggling the LED.
+ * task something to do so that the CPU doesn't just preempt to the next task.
+ * The busy wait counts CPU cycles, so time this task spends preempted doesn't
+ * count as brewing and progress stays exact to BREW_STEP.
+ * finishedAt is written before the last step so it is ready by the time the
+ * scheduler sees brewed reach target.
+ * The assignment is read again every step, so the scheduler takes a job off a worker
+ * just by changing it. workerCoffee says which Coffee the worker is in the middle of,
+ * and the scheduler won't hand that one to another worker until it changes. It is
+ * written before the assignment is checked again, so a job the scheduler moves between
+ * the two reads is never brewed by both.
+ * The LED is blinked by the scheduler's LED pattern, not from here.
  */
-void vBrewCoffeeType(void *pvParameters) {
-	Coffee coffeeType = *((Coffee *)pvParameters);	
-	Led_TypeDef ledForCoffeeType = getLEDForCoffeeType(coffeeType);
+void vBrewWorker(void *pvParameters) {
+	uint32_t worker = (uint32_t)pvParameters;
+	Coffee coffee;
+	BrewProgress *progress;
 	
 	for(;;) {
-		blinkLED(ledForCoffeeType);
-		TM_DelayMillis(BLINK_TOGGLE);
-		brewCounters[coffeeType] += BLINK_TOGGLE;
+		coffee = assignedCoffee[worker];
+		workerCoffee[worker] = coffee;
+		
+		if(coffee == DEFAULT_COFFEE || coffee != assignedCoffee[worker] || 
+				brewProgress[coffee].brewed >= brewProgress[coffee].target) {
+			// Nothing to brew until the scheduler hands over the next job
+			workerCoffee[worker] = DEFAULT_COFFEE;
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+		
+		progress = &brewProgress[coffee];
+		TM_DelayMillis(BREW_STEP);
 		
-		if(brewCounters[coffeeType] % (BLINK_TOGGLE * 2) == 0) {
-			taskTable[coffeeType].remainingWork--;
+		if(progress->brewed + BREW_STEP / portTICK_RATE_MS >= progress->target) {
+			progress->finishedAt = currentTime();
+		}
+		progress->brewed += BREW_STEP / portTICK_RATE_MS;
+	}
+}
+
+/*
+ * Begin/resume brewing a coffee type's oldest job on a worker
+ */
+void brewCoffeeType(Coffee coffee, uint32_t worker) {
+	Job *job = peekJob(&taskTable[coffee].jobs);
+	
+	if(job->startTime == JOB_NOT_STARTED) {
+		job->startTime = currentTime();
+	}
+	brewingCoffee = coffee;
+	brewingSince[worker] = currentTime();
+	setBrewTarget(coffee);
+	assignedCoffee[worker] = coffee;
+	xTaskNotifyGive(xBrewWorkers[worker]);
+}
+
+/*
+ * A worker that is free to take a Coffee type's job, or BREW_HEADS if there isn't one.
+ * The worker still in the middle of a step of it is the only one that may, and under
+ * PARTITIONED or SEMI_PARTITIONED only the job's own head may.
+ */
+uint32_t getFreeWorker(Coffee coffee) {
+	uint32_t head = getCoffeeHead(coffee);
+	uint32_t free = BREW_HEADS;
+	uint32_t i;
+	
+	for(i = 0; i < BREW_HEADS; i++) {
+		if(workerCoffee[i] == coffee && 
+				(assignedCoffee[i] != DEFAULT_COFFEE || (head != BREW_HEADS && head != i))) {
+			return BREW_HEADS;
+		} else if(workerCoffee[i] == coffee) {
+			return i;
+		} else if(assignedCoffee[i] == DEFAULT_COFFEE && free == BREW_HEADS && (head == BREW_HEADS || head == i)) {
+			free = i;
+		}
+	}
+	return free;
+}
+
+/*
+ * Hand the selected Coffee types' jobs to the workers. Jobs that are already brewing
+ * stay on their worker, since a worker can take another job at any step anyway.
+ */
+void assignBrews(Coffee *selected, uint32_t selectedCount) {
+	uint32_t selectedMask = 0;
+	uint32_t worker;
+	uint32_t i;
+#ifdef DISPATCH_TIMING
+	uint32_t dispatchStart = DWT->CYCCNT;
+	uint32_t dispatchCycles;
+#endif
+	
+	for(i = 0; i < selectedCount; i++) {
+		selectedMask |= 1 << selected[i];
+	}
+	
+	// Pause the brews that weren't selected, and move split jobs that are done with their first part
+	for(i = 0; i < BREW_HEADS; i++) {
+		if(assignedCoffee[i] != DEFAULT_COFFEE && !(selectedMask & (1 << assignedCoffee[i]))) {
+			assignedCoffee[i] = DEFAULT_COFFEE;
+			brewSwitches++;
+		} else if(assignedCoffee[i] != DEFAULT_COFFEE && getCoffeeHead(assignedCoffee[i]) != BREW_HEADS && 
+				getCoffeeHead(assignedCoffee[i]) != i) {
+			assignedCoffee[i] = DEFAULT_COFFEE;
+		}
+	}
+	
+	for(i = 0; i < selectedCount; i++) {
+		if(isBrewing(selected[i])) {
+			continue;
+		}
+		worker = getFreeWorker(selected[i]);
+		if(worker < BREW_HEADS) {
+			brewCoffeeType(selected[i], worker);
+		}
+	}
+	
+#ifdef DISPATCH_TIMING
+	dispatchCycles = DWT->CYCCNT - dispatchStart;
+	if(dispatchCycles > maxBrewDispatchCycles) {
+		maxBrewDispatchCycles = dispatchCycles;
+	}
+	totalBrewDispatchCycles += dispatchCycles;
+	brewDispatchCount++;
+#endif
+}
+
+/*
+ * With a server, move the brew targets of the coffees that are already brewing on
+ * with the jobs at the front of their rings, since a periodic job may have gone
+ * ahead of an order, and with the server's budget, which may have run out or come
+ * back since an order was handed to its worker.
+ */
+void updateOrderTargets() {
+#if defined(BUDGETED_SERVER) || defined(TOTAL_BANDWIDTH_SERVER)
+	int32_t i;
+	
+	for(i = 0; i < LEDn; i++) {
+		if(isBrewing(coffees[i])) {
+			setBrewTarget(coffees[i]);
+			xTaskNotifyGive(xBrewWorkers[getWorker(coffees[i])]);
+		}
+	}
+#endif
+}
+
+/*
+ * A single press moves the selection, a long press starts the selected Coffee
+ * and a double press starts every Coffee at once.
+ */
+void applyInputEvent(InputEvent *event) {
+	switch(event->type) {
+		case INPUT_SINGLE_PRESS:
+			selectNextCoffee();
+			break;
+		case INPUT_LONG_PRESS:
+			startCoffeeType(getSelectedCoffee());
+			break;
+		case INPUT_DOUBLE_PRESS:
+		case INPUT_START_ALL:
+			startAllCoffees();
+			break;
+		case INPUT_START:
+			startCoffeeType(event->coffee);
+			break;
+		case INPUT_ORDER:
+			orderCoffee(event->coffee, event->count);
+			break;
+	}
+}
+
+/*
+ * Pick up new input events and apply the ones that are due, in the order they arrived.
+ * Events asking to happen later wait in pendingInput.
+ */
+void handleInputEvents(int32_t now) {
+	InputEvent event;
+	uint32_t i;
+	uint32_t kept = 0;
+	
+	while(pendingInputCount < MAX_PENDING_INPUT && receiveInputEvent(&event)) {
+		event.at = now + event.at * 1000 / portTICK_RATE_MS; // Convert s to ticks
+		pendingInput[pendingInputCount++] = event;
+	}
+	
+	for(i = 0; i < pendingInputCount; i++) {
+		if(pendingInput[i].at <= now) {
+			applyInputEvent(&pendingInput[i]);
+		} else {
+			pendingInput[kept++] = pendingInput[i];
+			
+			// Come back for it when it is due rather than up to SCHEDULER_DELAY later
+			if((TickType_t)(pendingInput[i].at - now) < nextPassDelay) {
+				nextPassDelay = (TickType_t)(pendingInput[i].at - now);
+			}
+		}
+	}
+	pendingInputCount = kept;
+}
+
+/*
+ * Show each scheduled Coffee type's state on its LED. The ones brewing blink,
+ * getting brighter in quarters as it gets closer to done. The ones waiting for
+ * their turn glow dimly. The LED patterns only change when one of these does.
+ */
+void updateBrewLEDs() {
+	int32_t i;
+	int32_t total;
+	int32_t done;
+	Led_TypeDef led;
+	
+	for(i = 0; i < LEDn; i++) {
+		if(taskTable[i].jobs.count == 0) {
+			continue;
 		}
 		
-		if(brewCounters[coffeeType] >= getBrewDurations(coffeeType)) {
-			endBrew(coffeeType);
+		led = getLEDForCoffeeType(taskTable[i].type);
+		if(isBrewing(taskTable[i].type)) {
+			total = getBrewDurations(taskTable[i].type);
+			done = total - peekJob(&taskTable[i].jobs)->remainingWork;
+			setLEDPattern(led, LED_PATTERN_BLINK, LED_FULL_BRIGHTNESS * (1 + (3 * done) / total) / 4);
+		} else {
+			setLEDPattern(led, LED_PATTERN_ON, LED_WAITING_BRIGHTNESS);
+		}
+	}
+}
+
+/*
+ * Runs in the timer daemon task each time a started Coffee's period comes around.
+ * The release is stamped with the time it should have happened rather than when the
+ * callback ran, so lateness here never shifts a deadline.
+ */
+void vReleaseTimerCallback(TimerHandle_t xTimer) {
+	Coffee type = (Coffee)(uint32_t)pvTimerGetTimerID(xTimer);
+	CoffeeTask *task = &taskTable[type];
+	Release release;
+	uint32_t jitter;
+	
+	task->releases++;
+	release.type = type;
+	release.time = task->startTime + task->releases * (getCoffeePeriod(type) / portTICK_RATE_MS);
+	release.deadline = release.time + getCoffeeDeadline(type) / portTICK_RATE_MS;
+	
+	jitter = (uint32_t)(currentTime() - release.time);
+	if(jitter > maxReleaseJitter) {
+		maxReleaseJitter = jitter;
+	}
+	releaseCount++;
+	
+	xQueueSend(xReleaseQueue, &release, 0);
+}
+
+/*
+ * Queue a job for a released Coffee. A job that doesn't fit will never brew, so it
+ * counts as a missed deadline straight away.
+ */
+void releaseCoffee(Release *release) {
+	if(taskTable[release->type].jobs.count == 0) {
+		wakeReservation(release->type, release->time, release->deadline);
+	}
+	if(!pushJob(&taskTable[release->type].jobs, release->time, release->deadline, 
+			(getBrewDurations(release->type) + getBrewOverrun(release->type)) / portTICK_RATE_MS)) {
+		missedDeadlines++;
+	}
+}
+
+/*
+ * Queue a one-off order for the aperiodic server. Under TOTAL_BANDWIDTH_SERVER its
+ * deadline is when the server's share of the machine would have brewed it, after
+ * the orders before it, or the latest there is if the server has no share.
+ */
+void releaseOrder(Release *release) {
+#ifdef TOTAL_BANDWIDTH_SERVER
+	if(serverCapacity == 0) {
+		release->deadline = 0x7FFFFFFF;
+	} else {
+		if(bandwidthDeadline < release->time) {
+			bandwidthDeadline = release->time;
 		}
-		vTaskDelay(10 / portTICK_RATE_MS);
+		bandwidthDeadline += getBrewDurations(release->type) * SERVER_PERIOD / serverCapacity / portTICK_RATE_MS;
+		release->deadline = bandwidthDeadline;
+	}
+#endif
+	if(!pushOrder(&taskTable[release->type].jobs, release->time, release->deadline,
+			getBrewDurations(release->type) / portTICK_RATE_MS)) {
+		droppedOrders++;
 	}
 }
 
 /*
- * Begin/resume brewing a coffee type
+ * Apply a Coffee type's OverloadPolicy to its waiting jobs.
  */
-void brewCoffeeType(Coffee coffee) {
-	vTaskResume(xBrewTasks[coffee]);
+void handleOverload(Coffee type, int32_t now) {
+	JobRing *jobs = &taskTable[type].jobs;
+	uint32_t aborted;
+	
+	switch(getCoffeeOverloadPolicy(type)) {
+		case OVERLOAD_ABORT:
+			aborted = abortLateJobs(jobs, now);
+			if(aborted > 0) {
+				// The brew in progress may have been one of them, start the next one from scratch
+				stopBrew(type);
+				setBrewTarget(type);
+				turnOffLED(getLEDForCoffeeType(type));
+				abortedJobs += aborted;
+				missedDeadlines += aborted;
+			}
+			break;
+		case OVERLOAD_DEGRADE:
+			if(degradeLateJob(jobs, now, (getBrewDurations(type) - getDegradedBrewDuration(type)) / portTICK_RATE_MS)) {
+				degradedJobs++;
+				if(peekJob(jobs)->remainingWork <= 0) {
+					endBrew(type, now);
+				} else {
+					setBrewTarget(type);
+				}
+			}
+			break;
+		default:
+			break;
+	}
 }
 
 /*
- * Run every second to reevaluate which coffee should be brewing depending
- * on each coffee tpye's deadline, period and priority.
+ * Reevaluate which coffee should be brewing depending on each coffee type's
+ * deadline, period and priority. This happens as soon as a coffee is released or
+ * a brew should be done, and at least every SCHEDULER_DELAY otherwise.
  */
 void vScheduler(void *pvParameters) {
 	Coffee scheduled[LEDn];
 	int32_t scheduledCount;
-	Coffee selectedCoffeeToBrew;
+	Coffee selected[BREW_HEADS];
+	uint32_t selectedCount;
+	uint32_t selectedMask;
+	uint32_t head;
 	int32_t i;
 	uint32_t missedDeadlinesCopy; // leaving this here for debugging/demo purposes
-	int32_t ticksSinceStart = -1;
+	int32_t firstReleaseTime = -1;
+	int32_t now;
+	Release release;
+	uint32_t released;
+#ifdef DISPATCH_TIMING
+	uint32_t passStart;
+#endif
 	
 	for(;;) {
-		if(xSemaphoreTake(xTaskTableSemaphore, 0)) {	
-			missedDeadlinesCopy = missedDeadlines;
-			
-			// Schedule coffees to brew if their period is reached
-			for(i = 0; i < LEDn; i++) {			
-				if(taskTable[i].started && 
-					((ticks - taskTable[i].startTime) % getCoffeePeriod(taskTable[i].type) == 0)) {
-					if(ticksSinceStart == -1) {
-						ticksSinceStart = 0;
-					}
-					taskTable[i].scheduled++;
-					taskTable[i].deadline = ticks + getCoffeeDeadline(taskTable[i].type);
-					taskTable[i].remainingWork = getBrewDurations(taskTable[i].type) / 1000; // Convert ms to s
-				}
+		// Sleep until a coffee is released or the delay runs out
+		released = xQueueReceive(xReleaseQueue, &release, nextPassDelay) == pdTRUE;
+#ifdef DISPATCH_TIMING
+		passStart = DWT->CYCCNT;
+#endif
+		nextPassDelay = SCHEDULER_DELAY / portTICK_RATE_MS;
+		
+		now = currentTime();
+		collectBrewProgress();
+		replenishServer(now);
+		missedDeadlinesCopy = missedDeadlines;
+		
+		handleInputEvents(now);
+		
+		// Schedule every coffee whose period has come around
+		while(released) {
+			if(firstReleaseTime == -1) {
+				firstReleaseTime = release.time;
 			}
+			if(getCoffeeOverloadPolicy(release.type) == OVERLOAD_SKIP && taskTable[release.type].jobs.count > 0) {
+				skippedJobs++;
+			} else {
+				releaseCoffee(&release);
+			}
+			released = xQueueReceive(xReleaseQueue, &release, 0) == pdTRUE;
+		}
 		
+		for(i = 0; i < LEDn; i++) {
+			handleOverload(coffees[i], now);
+		}
+		
+		if(dispatchFromTable(now, &selected[0])) {
+			selectedCount = selected[0] != DEFAULT_COFFEE;
+		} else {
 			scheduledCount = 0;
 			for(i = 0; i < LEDn; i++) {			
-				if(taskTable[i].scheduled > 0) {
+				if(taskTable[i].jobs.count > 0) {
 					scheduled[scheduledCount] = taskTable[i].type;
 					scheduledCount++;
 				}
 			}
-		
+			
 #ifdef FIXED_PRIORITY
 			schedule_FixedPriority(scheduled, scheduledCount);
 #elif defined(EARLIEST_DEADLINE_FIRST)
 			schedule_EarliestDeadlineFirst(scheduled, scheduledCount);
 #elif defined(LEAST_LAXITY_FIRST)
 			schedule_LeastLaxityFirst(scheduled, scheduledCount);
+#elif defined(LEAST_LAXITY_FIRST_THRESHOLD)
+			schedule_LeastLaxityFirstThreshold(scheduled, scheduledCount);
+#elif defined(RATE_MONOTONIC)
+			schedule_RateMonotonic(scheduled, scheduledCount);
+#elif defined(DEADLINE_MONOTONIC)
+			schedule_DeadlineMonotonic(scheduled, scheduledCount);
+#elif defined(AUDSLEY)
+			schedule_Audsley(scheduled, scheduledCount);
+#elif defined(ROUND_ROBIN)
+			schedule_RoundRobin(scheduled, scheduledCount);
+#elif defined(STRIDE)
+			schedule_Stride(scheduled, scheduledCount);
 #endif
-		
-			selectedCoffeeToBrew = getHighestPriorityTask();
-		
-			if(selectedCoffeeToBrew != DEFAULT_COFFEE) {	
-				pauseAllBrews();
-				brewCoffeeType(selectedCoffeeToBrew);		
-			}
-		
-			ticks++;
-			if(ticksSinceStart != -1) {
-				ticksSinceStart++;
-			}
+			prioritiseOrders(scheduled, scheduledCount);
+			prioritiseFirstParts(scheduled, scheduledCount);
 			
-			// Set a break point here to see how many deadlines we missed after 100 cycles.
-			if(ticksSinceStart > 100) {
-				i = missedDeadlinesCopy; // I know what you're thinking, we need to use missedDeadlinesCopy or else we can't view it in the debugger.
-				while(1);  
+			// One job for each brew head, from the ones that may brew on it and aren't held
+			selectedMask = getHeldOrdersMask(now);
+			selectedCount = 0;
+			for(head = 0; head < BREW_HEADS; head++) {
+				selected[selectedCount] = getHighestPriorityTask(selectedMask | getOtherHeadsMask(head));
+				if(selected[selectedCount] != DEFAULT_COFFEE) {
+					selectedMask |= 1 << selected[selectedCount];
+					selectedCount++;
+				}
 			}
-			
-			xSemaphoreGive(xTaskTableSemaphore);
-			vTaskDelay( SCHEDULER_DELAY / portTICK_RATE_MS );
+		}
+		
+		assignBrews(selected, selectedCount);
+		updateOrderTargets();
+		trackServerActivity(now);
+		passWhenBrewsEnd();
+		lastPassTime = now;
+		updateBrewLEDs();
+#ifdef DISPATCH_TIMING
+		if(DWT->CYCCNT - passStart > maxPassCycles) {
+			maxPassCycles = DWT->CYCCNT - passStart;
+		}
+#endif
+		
+		// Set a break point here to see how many deadlines we missed after RUN_TIME.
+		if(firstReleaseTime != -1 && now - firstReleaseTime > RUN_TIME / portTICK_RATE_MS) {
+			i = missedDeadlinesCopy; // I know what you're thinking, we need to use missedDeadlinesCopy or else we can't view it in the debugger.
+			while(1);  
 		}
 	}
 }
 
+/*
+ * Release a Coffee type now and then every period from its release timer.
+ */
 void startCoffeeType(Coffee type) {
+	Release release;
+	
+	if(taskTable[type].started) {
+		return;
+	}
+	
 	taskTable[type].started = 1;
-	taskTable[type].startTime = ticks;
+	taskTable[type].startTime = currentTime();
+	taskTable[type].releases = 0;
 	turnOffLED(getLEDForCoffeeType(type));
+	
+	release.type = type;
+	release.time = taskTable[type].startTime;
+	release.deadline = release.time + getCoffeeDeadline(type) / portTICK_RATE_MS;
+	releaseCoffee(&release);
+	
+	// Start the period from startTime rather than from the tick count now, or a tick
+	// that came in since would make every later release of this coffee a tick late
+	xTimerGenericCommand(xReleaseTimers[type], tmrCOMMAND_RESET, (TickType_t)taskTable[type].startTime, NULL, 0);
+	
+	sizeServer();
 }
 
 void startAllCoffees() {
@@ -323,6 +1649,30 @@ void startAllCoffees() {
 	}
 }
 
+/*
+ * Brew count of a Coffee type once, on top of anything it already has scheduled.
+ * Each one is a job released now.
+ */
+void orderCoffee(Coffee type, uint32_t count) {
+	Release release;
+	
+	release.type = type;
+	release.time = currentTime();
+	release.deadline = release.time + getCoffeeDeadline(type) / portTICK_RATE_MS;
+	
+	// More than the ring holds would only be dropped, one at a time
+	if(count > JOB_RING_SIZE) {
+		count = JOB_RING_SIZE;
+	}
+	while(count-- > 0) {
+#if defined(BUDGETED_SERVER) || defined(TOTAL_BANDWIDTH_SERVER)
+		releaseOrder(&release);
+#else
+		releaseCoffee(&release);
+#endif
+	}
+}
+
 /*
  * Move the user through the Coffee selection menu skipping any Coffees that are already being brewed.
  */
@@ -338,36 +1688,3 @@ void selectNextCoffee() {
 	resetAllLEDs();
 	turnOnLED(selectedLED);
 }
-
-/* 
- * Poll the button for input. If a short click is detecting change the selection.
- * If a long click is selected begin brewing.
- */
-void vButtonUpdate(void *pvParameters) {
-	uint32_t debounce_count = 0;
-	
-	for(;;) {		
-		if(STM_EVAL_PBGetState(BUTTON_USER)) {
-			debounce_count++;
-			TM_DelayMillis(10);
-		} else if(debounce_count > LONG_PRESS_THRESHOLD) {
-#ifdef DIFFERENT_START_TIME
-			startCoffeeType(getSelectedCoffee());
-#endif
-			debounce_count = 0;
-			vTaskDelay(200 / portTICK_RATE_MS);
-		} else if(debounce_count > SHORT_PRESS_THRESHOLD) {
-#ifdef SAME_START_TIME
-			startAllCoffees();
-#elif defined(DIFFERENT_START_TIME)
-			selectNextCoffee();
-#endif
-			debounce_count = 0;
-			vTaskDelay(200 / portTICK_RATE_MS);
-		}
-		else {
-			debounce_count = 0;
-			vTaskDelay(BUTTON_DELAY / portTICK_RATE_MS);
-		}
-	}
-}
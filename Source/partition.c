@@ -0,0 +1,503 @@
+#include "partition.h"
+
+// Furthest the EDF demand test looks when a head is fully loaded
+#define MAX_DEMAND_HORIZON 3600000
+
+// Most periodic jobs the server sizing looks at, a little over two hyperperiods
+#define MAX_SERVER_JOBS 256
+
+// splitHead of a split load whose second part hasn't found a head yet
+#define SPLIT_PENDING (NO_HEAD + 1)
+
+/*
+ * The part of a load that brews on one head.
+ */
+typedef struct {
+	uint32_t work;
+	uint32_t deadline;
+	uint32_t period;
+	uint32_t first;		// the first part of a split job, which goes ahead of everything else
+} Piece;
+
+/*
+ * The part of load i that brews on head, if any. Loads that haven't been placed have none.
+ */
+static uint32_t getPiece(const BrewLoad *loads, const HeadAssignment *assignments, uint32_t i, uint32_t head, Piece *piece) {
+	piece->period = loads[i].period;
+	piece->first = 0;
+	
+	if(assignments[i].head == head && assignments[i].splitHead == NO_HEAD) {
+		piece->work = loads[i].work;
+		piece->deadline = loads[i].deadline;
+	} else if(assignments[i].head == head) {
+		// Split C=D: the first part has no slack, so it brews as soon as it is released
+		piece->work = assignments[i].splitWork;
+		piece->deadline = assignments[i].splitWork;
+		piece->first = 1;
+	} else if(assignments[i].splitHead == head) {
+		piece->work = loads[i].work - assignments[i].splitWork;
+		piece->deadline = loads[i].deadline - assignments[i].splitWork;
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+static double getHeadUtilisation(const BrewLoad *loads, uint32_t count, const HeadAssignment *assignments, uint32_t head) {
+	Piece piece;
+	double u = 0;
+	uint32_t i;
+	
+	for(i = 0; i < count; i++) {
+		if(getPiece(loads, assignments, i, head, &piece)) {
+			u += (double)piece.work / piece.period;
+		}
+	}
+	return u;
+}
+
+/*
+ * The most work released on head that has to be done by t.
+ */
+static uint64_t getDemand(const BrewLoad *loads, uint32_t count, const HeadAssignment *assignments, uint32_t head, uint32_t t) {
+	Piece piece;
+	uint64_t demand = 0;
+	uint32_t i;
+	
+	for(i = 0; i < count; i++) {
+		if(getPiece(loads, assignments, i, head, &piece) && t >= piece.deadline) {
+			demand += (uint64_t)((t - piece.deadline) / piece.period + 1) * piece.work;
+		}
+	}
+	return demand;
+}
+
+/*
+ * Exact EDF test for one head: the demand by every deadline up to the point where
+ * it could first exceed the time available has to fit.
+ */
+static uint32_t edfHeadSchedulable(const BrewLoad *loads, uint32_t count, const HeadAssignment *assignments, uint32_t head) {
+	double u = getHeadUtilisation(loads, count, assignments, head);
+	double slack = 0;
+	double horizon = 0;
+	uint32_t longest = 0;
+	Piece piece;
+	uint32_t i;
+	uint32_t t;
+	
+	if(u > 1) {
+		return 0;
+	}
+	
+	// Baruah's bound on how far the demand has to be checked
+	for(i = 0; i < count; i++) {
+		if(getPiece(loads, assignments, i, head, &piece)) {
+			slack += (double)(piece.period - piece.deadline) * piece.work / piece.period;
+			if(piece.deadline > longest) {
+				longest = piece.deadline;
+			}
+		}
+	}
+	horizon = u < 1 ? slack / (1 - u) : MAX_DEMAND_HORIZON;
+	if(horizon < longest) {
+		horizon = longest;
+	}
+	if(horizon > MAX_DEMAND_HORIZON) {
+		horizon = MAX_DEMAND_HORIZON;
+	}
+	
+	for(i = 0; i < count; i++) {
+		if(!getPiece(loads, assignments, i, head, &piece)) {
+			continue;
+		}
+		for(t = piece.deadline; t <= horizon; t += piece.period) {
+			if(getDemand(loads, count, assignments, head, t) > t) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Whether piece a of load i goes ahead of piece b of load j under rate monotonic:
+ * first parts of split jobs, then shorter periods, then shorter deadlines.
+ */
+static uint32_t isHigherPriority(const Piece *a, uint32_t i, const Piece *b, uint32_t j) {
+	if(a->first != b->first) {
+		return a->first;
+	}
+	if(a->period != b->period) {
+		return a->period < b->period;
+	}
+	if(a->deadline != b->deadline) {
+		return a->deadline < b->deadline;
+	}
+	return i < j;
+}
+
+/*
+ * Response time analysis for one head under rate monotonic.
+ */
+static uint32_t rateMonotonicHeadSchedulable(const BrewLoad *loads, uint32_t count, const HeadAssignment *assignments, uint32_t head) {
+	Piece piece;
+	Piece other;
+	uint32_t response;
+	uint32_t previous;
+	uint32_t i;
+	uint32_t j;
+	
+	for(i = 0; i < count; i++) {
+		if(!getPiece(loads, assignments, i, head, &piece)) {
+			continue;
+		}
+		
+		response = piece.work;
+		previous = 0;
+		while(response != previous && response <= piece.deadline) {
+			previous = response;
+			response = piece.work;
+			for(j = 0; j < count; j++) {
+				if(j != i && getPiece(loads, assignments, j, head, &other) && isHigherPriority(&other, j, &piece, i)) {
+					response += ((previous + other.period - 1) / other.period) * other.work;
+				}
+			}
+		}
+		if(response > piece.deadline) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static uint32_t headSchedulable(const BrewLoad *loads, uint32_t count, const HeadAssignment *assignments,
+		uint32_t head, HeadScheduler scheduler) {
+	if(scheduler == HEAD_EARLIEST_DEADLINE_FIRST) {
+		return edfHeadSchedulable(loads, count, assignments, head);
+	}
+	return rateMonotonicHeadSchedulable(loads, count, assignments, head);
+}
+
+/*
+ * Global EDF density test (Goossens, Funk and Baruah, with density for constrained
+ * deadlines): every deadline is met on heads brew heads if the total density is at
+ * most heads - (heads - 1) * the largest density. Sufficient, not exact.
+ */
+uint32_t globalEdfSchedulable(const BrewLoad *loads, uint32_t count, uint32_t heads) {
+	double density;
+	double total = 0;
+	double largest = 0;
+	uint32_t i;
+	
+	for(i = 0; i < count; i++) {
+		density = (double)loads[i].work / loads[i].deadline;
+		total += density;
+		if(density > largest) {
+			largest = density;
+		}
+	}
+	return largest <= 1 && total <= heads - (heads - 1) * largest;
+}
+
+/*
+ * Split load i C=D style: as much of each job as still fits on one head brews there
+ * first, and the rest has to fit on another head by the job's deadline.
+ */
+static uint32_t placeSplit(const BrewLoad *loads, uint32_t count, uint32_t heads, HeadScheduler scheduler,
+		HeadAssignment *assignments, uint32_t i) {
+	uint32_t low;
+	uint32_t high;
+	uint32_t middle;
+	uint32_t head;
+	uint32_t splitHead;
+	
+	for(head = 0; head < heads; head++) {
+		// The most of each job that still fits on head, 0 if none does
+		assignments[i].head = head;
+		assignments[i].splitHead = SPLIT_PENDING;
+		low = 0;
+		high = loads[i].work - 1;
+		while(low < high) {
+			middle = (low + high + 1) / 2;
+			assignments[i].splitWork = middle;
+			if(headSchedulable(loads, count, assignments, head, scheduler)) {
+				low = middle;
+			} else {
+				high = middle - 1;
+			}
+		}
+		if(low == 0) {
+			continue;
+		}
+		assignments[i].splitWork = low;
+		
+		for(splitHead = 0; splitHead < heads; splitHead++) {
+			assignments[i].splitHead = splitHead;
+			if(splitHead != head && headSchedulable(loads, count, assignments, splitHead, scheduler)) {
+				return 1;
+			}
+		}
+	}
+	
+	assignments[i].head = NO_HEAD;
+	assignments[i].splitHead = NO_HEAD;
+	assignments[i].splitWork = 0;
+	return 0;
+}
+
+/*
+ * Place loads onto heads brew heads first fit decreasing: in order of falling
+ * utilisation each load goes on the first head that is still schedulable with it.
+ * With split set a load that fits on no head whole is split across two. Loads that
+ * didn't fit go on the least loaded head anyway, so every load has a head. Returns
+ * how many didn't fit.
+ */
+static uint32_t placeLoads(const BrewLoad *loads, uint32_t count, uint32_t heads, HeadScheduler scheduler,
+		uint32_t split, HeadAssignment *assignments) {
+	uint32_t order[MAX_BREW_LOADS];
+	uint32_t unplaced = 0;
+	uint32_t least;
+	uint32_t head;
+	uint32_t i;
+	uint32_t j;
+	
+	for(i = 0; i < count; i++) {
+		assignments[i].head = NO_HEAD;
+		assignments[i].splitHead = NO_HEAD;
+		assignments[i].splitWork = 0;
+		
+		// Insertion sort by falling utilisation
+		for(j = i; j > 0 && (uint64_t)loads[i].work * loads[order[j - 1]].period >
+				(uint64_t)loads[order[j - 1]].work * loads[i].period; j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+	}
+	
+	for(j = 0; j < count; j++) {
+		i = order[j];
+		for(head = 0; head < heads && assignments[i].head == NO_HEAD; head++) {
+			assignments[i].head = head;
+			if(!headSchedulable(loads, count, assignments, head, scheduler)) {
+				assignments[i].head = NO_HEAD;
+			}
+		}
+		if(assignments[i].head != NO_HEAD || (split && placeSplit(loads, count, heads, scheduler, assignments, i))) {
+			continue;
+		}
+		
+		unplaced++;
+		least = 0;
+		for(head = 1; head < heads; head++) {
+			if(getHeadUtilisation(loads, count, assignments, head) < getHeadUtilisation(loads, count, assignments, least)) {
+				least = head;
+			}
+		}
+		assignments[i].head = least;
+	}
+	return unplaced;
+}
+
+/*
+ * Partition loads onto heads brew heads with placeLoads, and return whether every
+ * load fit. With split set, loads are only split when that makes every one of them
+ * fit. A split takes room on two heads, so when some loads still don't fit the ones
+ * dumped on the least loaded head can end up worse off than without it.
+ */
+uint32_t partitionLoads(const BrewLoad *loads, uint32_t count, uint32_t heads, HeadScheduler scheduler,
+		uint32_t split, HeadAssignment *assignments) {
+	// Too big for a task's stack, and only ever used by one task at a time
+	static HeadAssignment splitAssignments[MAX_BREW_LOADS];
+	uint32_t unplaced = placeLoads(loads, count, heads, scheduler, 0, assignments);
+	uint32_t i;
+	
+	if(!split || unplaced == 0) {
+		return unplaced == 0;
+	}
+	if(placeLoads(loads, count, heads, scheduler, 1, splitAssignments) > 0) {
+		return 0;
+	}
+	for(i = 0; i < count; i++) {
+		assignments[i] = splitAssignments[i];
+	}
+	return 1;
+}
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+	uint32_t remainder;
+	
+	while(b != 0) {
+		remainder = a % b;
+		a = b;
+		b = remainder;
+	}
+	return a;
+}
+
+// The periodic jobs the server sizing checks against, in deadline order. Far too big
+// for the scheduler's stack, and only ever used by one task at a time
+static uint32_t serverJobRelease[MAX_SERVER_JOBS];
+static uint32_t serverJobDeadline[MAX_SERVER_JOBS];
+static uint32_t serverJobWork[MAX_SERVER_JOBS];
+static uint32_t serverJobCount;
+
+/*
+ * The most a server can need done inside a window of length, ms. A sporadic server
+ * has to use each budget within a period of when it started using it, so it needs
+ * no more than a periodic task would. A deferrable server can spend a whole budget
+ * at the very end of one period and another at the start of the next, so a window
+ * can start with a budget that is due almost at once. A total bandwidth server needs
+ * its share of the window.
+ */
+static uint64_t getServerDemand(uint32_t budget, uint32_t period, ServerKind kind, uint32_t length) {
+	switch(kind) {
+		case SERVER_TOTAL_BANDWIDTH:
+			return (uint64_t)budget * length / period;
+		case SERVER_SPORADIC:
+			return (uint64_t)(length / period) * budget;
+		default:
+			if(length < budget) {
+				return length;
+			}
+			return budget + (uint64_t)((length - budget) / period) * budget;
+	}
+}
+
+/*
+ * The first window length at or after length where the server's demand goes up in a
+ * step, or 0xFFFFFFFF if it never does. A total bandwidth server's goes up evenly.
+ */
+static uint32_t getServerStep(uint32_t budget, uint32_t period, ServerKind kind, uint32_t length) {
+	uint32_t first = kind == SERVER_DEFERRABLE ? budget : period;
+	
+	if(kind == SERVER_TOTAL_BANDWIDTH) {
+		return 0xFFFFFFFF;
+	}
+	if(length <= first) {
+		return first;
+	}
+	return first + (length - first + period - 1) / period * period;
+}
+
+/*
+ * EDF demand test for the server's jobs next to a server that can start at any time.
+ * Every window that starts at a release in one hyperperiod, and ends at a deadline or
+ * where the server's demand steps up, has to fit its jobs and the server's demand.
+ * The jobs are in deadline order, so one pass over them for each start is enough.
+ */
+static uint32_t serverFits(uint32_t hyperperiod, uint32_t started, uint32_t longest, uint32_t period,
+		uint32_t budget, ServerKind kind) {
+	uint32_t limit = hyperperiod + longest;
+	uint64_t demand;
+	uint32_t length;
+	uint32_t step;
+	uint32_t i;
+	uint32_t j;
+	
+	for(i = 0; i < serverJobCount; i++) {
+		if(serverJobRelease[i] < started || serverJobRelease[i] >= started + hyperperiod) {
+			continue;
+		}
+		demand = 0;
+		step = getServerStep(budget, period, kind, 1);
+		for(j = 0; j < serverJobCount; j++) {
+			if(serverJobDeadline[j] <= serverJobRelease[i]) {
+				continue;
+			}
+			length = serverJobDeadline[j] - serverJobRelease[i];
+			if(length > limit) {
+				break;
+			}
+			for(; step < length; step = getServerStep(budget, period, kind, step + 1)) {
+				if(demand + getServerDemand(budget, period, kind, step) > step) {
+					return 0;
+				}
+			}
+			if(serverJobRelease[j] >= serverJobRelease[i]) {
+				demand += serverJobWork[j];
+			}
+			if(demand + getServerDemand(budget, period, kind, length) > length) {
+				return 0;
+			}
+		}
+		
+		// and the server's steps after the last deadline
+		for(; step <= limit; step = getServerStep(budget, period, kind, step + 1)) {
+			if(demand + getServerDemand(budget, period, kind, step) > step) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * The largest budget a server of kind can get every period without any of the loads,
+ * released every period from phases on, missing a deadline under EDF, or 0 if there
+ * is none. For a total bandwidth server it is its share of each period. All times are
+ * in ms.
+ * The periodic jobs are worked out once, in deadline order, and each budget tried
+ * costs one pass over them, and over the server's steps, for each release in a
+ * hyperperiod. For our catalog that is a few thousand steps a budget, and with
+ * MAX_SERVER_JOBS and MAX_DEMAND_HORIZON it can't go much over a million in all.
+ */
+uint32_t getServerBudget(const BrewLoad *loads, const uint32_t *phases, uint32_t count, uint32_t period,
+		ServerKind kind) {
+	uint32_t hyperperiod = period;
+	uint32_t started = 0;
+	uint32_t longest = 0;
+	uint32_t low = 0;
+	uint32_t high = period;
+	uint32_t middle;
+	double u = 0;
+	uint32_t t;
+	uint32_t i;
+	uint32_t j;
+	
+	for(i = 0; i < count; i++) {
+		u += (double)loads[i].work / loads[i].period;
+		hyperperiod = hyperperiod / greatestCommonDivisor(hyperperiod, loads[i].period) * loads[i].period;
+		if(hyperperiod > MAX_DEMAND_HORIZON) {
+			return 0;
+		}
+		if(phases[i] > started) {
+			started = phases[i];
+		}
+		if(loads[i].deadline > longest) {
+			longest = loads[i].deadline;
+		}
+	}
+	if(u > 1) {
+		return 0;
+	}
+	
+	// Every job released up to two hyperperiods after the last load started, in
+	// deadline order
+	serverJobCount = 0;
+	for(i = 0; i < count; i++) {
+		for(t = phases[i]; t < started + 2 * hyperperiod + longest; t += loads[i].period) {
+			if(serverJobCount == MAX_SERVER_JOBS) {
+				return 0;
+			}
+			for(j = serverJobCount; j > 0 && serverJobDeadline[j - 1] > t + loads[i].deadline; j--) {
+				serverJobRelease[j] = serverJobRelease[j - 1];
+				serverJobDeadline[j] = serverJobDeadline[j - 1];
+				serverJobWork[j] = serverJobWork[j - 1];
+			}
+			serverJobRelease[j] = t;
+			serverJobDeadline[j] = t + loads[i].deadline;
+			serverJobWork[j] = loads[i].work;
+			serverJobCount++;
+		}
+	}
+	
+	while(low < high) {
+		middle = (low + high + 1) / 2;
+		if(u + (double)middle / period <= 1 && serverFits(hyperperiod, started, longest, period, middle, kind)) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+	return low;
+}
@@ -0,0 +1,52 @@
+#ifndef _PARTITION_H
+#define _PARTITION_H
+
+#include <stdint.h>
+
+// Most brew heads and brew streams the schedulability tests handle
+#define MAX_BREW_HEADS 8
+#define MAX_BREW_LOADS 32
+
+#define NO_HEAD MAX_BREW_HEADS
+
+/*
+ * One periodic stream of brews, such as one Coffee type. All times are in ms.
+ */
+typedef struct {
+	uint32_t work;
+	uint32_t deadline;	// relative, no longer than period
+	uint32_t period;
+} BrewLoad;
+
+/*
+ * How each brew head orders the jobs partitioned onto it.
+ */
+typedef enum {
+	HEAD_EARLIEST_DEADLINE_FIRST,
+	HEAD_RATE_MONOTONIC
+} HeadScheduler;
+
+/*
+ * Which brew head a stream's jobs brew on. A split job brews its first splitWork ms
+ * on head ahead of everything else there, then moves to splitHead for the rest.
+ */
+typedef struct {
+	uint32_t head;
+	uint32_t splitHead;	// NO_HEAD unless the stream is split
+	uint32_t splitWork;
+} HeadAssignment;
+
+/*
+ * The kinds of aperiodic server a budget can be worked out for.
+ */
+typedef enum {
+	SERVER_DEFERRABLE,
+	SERVER_SPORADIC,
+	SERVER_TOTAL_BANDWIDTH
+} ServerKind;
+
+uint32_t globalEdfSchedulable(const BrewLoad *, uint32_t, uint32_t);
+uint32_t partitionLoads(const BrewLoad *, uint32_t, uint32_t, HeadScheduler, uint32_t, HeadAssignment *);
+uint32_t getServerBudget(const BrewLoad *, const uint32_t *, uint32_t, uint32_t, ServerKind);
+
+#endif
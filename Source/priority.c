@@ -0,0 +1,102 @@
+#include "priority.h"
+
+/*
+ * Worst case time from a load's release to the end of its brew under fixed priority
+ * scheduling, when every load in the higher bit mask can preempt it. Stops as soon
+ * as the response time passes the load's deadline.
+ */
+uint32_t getResponseTime(const BrewLoad *loads, uint32_t count, uint32_t load, uint32_t higher) {
+	uint32_t response = loads[load].work;
+	uint32_t previous = 0;
+	uint32_t i;
+	
+	while(response != previous && response <= loads[load].deadline) {
+		previous = response;
+		response = loads[load].work;
+		for(i = 0; i < count; i++) {
+			if(higher & (1 << i)) {
+				response += ((previous + loads[i].period - 1) / loads[i].period) * loads[i].work;
+			}
+		}
+	}
+	return response;
+}
+
+/*
+ * Audsley's optimal priority assignment. Fills the lowest priority level first with any
+ * load that still meets its deadline with all the unassigned ones above it, which finds
+ * a fixed priority order that meets every deadline whenever there is one.
+ * Priorities go from 1 (lowest) to count, which is at most MAX_BREW_LOADS. Returns 0 if
+ * no such order exists, in which case the levels nothing fit into are filled in
+ * deadline monotonic order.
+ */
+uint32_t assignAudsleyPriorities(const BrewLoad *loads, uint32_t count, int32_t *priorities) {
+	uint32_t unassigned = count == 0 ? 0 : 0xFFFFFFFF >> (32 - count);
+	uint32_t schedulable = 1;
+	uint32_t level;
+	uint32_t i;
+	uint32_t chosen;
+	
+	for(level = 1; level <= count; level++) {
+		chosen = count;
+		for(i = 0; i < count && chosen == count; i++) {
+			if((unassigned & (1 << i)) && 
+					getResponseTime(loads, count, i, unassigned & ~(1 << i)) <= loads[i].deadline) {
+				chosen = i;
+			}
+		}
+		
+		if(chosen == count) {
+			schedulable = 0;
+			for(i = 0; i < count; i++) {
+				if((unassigned & (1 << i)) && 
+						(chosen == count || loads[i].deadline > loads[chosen].deadline)) {
+					chosen = i;
+				}
+			}
+		}
+		
+		priorities[chosen] = level;
+		unassigned &= ~(1 << chosen);
+	}
+	return schedulable;
+}
+
+/*
+ * Whether no load before this one has the same relative deadline.
+ */
+static uint32_t firstWithDeadline(const BrewLoad *loads, uint32_t load) {
+	uint32_t i;
+	
+	for(i = 0; i < load; i++) {
+		if(loads[i].deadline == loads[load].deadline) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Stack Resource Policy preemption levels. The shorter a load's relative deadline the
+ * higher its level, and loads with the same deadline share a level. Levels go from 0
+ * (lowest) up. Returns how many levels there are.
+ */
+uint32_t assignPreemptionLevels(const BrewLoad *loads, uint32_t count, uint32_t *levels) {
+	uint32_t levelCount = 0;
+	uint32_t i;
+	uint32_t j;
+	
+	for(i = 0; i < count; i++) {
+		levels[i] = 0;
+		for(j = 0; j < count; j++) {
+			// Count each longer deadline once, at the first load that has it
+			if(loads[j].deadline > loads[i].deadline && firstWithDeadline(loads, j)) {
+				levels[i]++;
+			}
+		}
+		if(firstWithDeadline(loads, i)) {
+			levelCount++;
+		}
+	}
+	return levelCount;
+}
@@ -0,0 +1,10 @@
+#ifndef _PRIORITY_H
+#define _PRIORITY_H
+
+#include "partition.h"
+
+uint32_t getResponseTime(const BrewLoad *, uint32_t, uint32_t, uint32_t);
+uint32_t assignAudsleyPriorities(const BrewLoad *, uint32_t, int32_t *);
+uint32_t assignPreemptionLevels(const BrewLoad *, uint32_t, uint32_t *);
+
+#endif
@@ -3,38 +3,83 @@
 #include "stm32f4xx.h"
 #include "stm32f4xx_gpio.h"
 #include "stm32f4xx_rcc.h"
+#include "stm32f4xx_dma.h"
+#include "misc.h"
 #include "codec.h"
+#include "synth.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+//#define SOUND_BENCHMARK
 
 //Defines
-#define NOTEFREQUENCY 0.015		//frequency of saw wave: f0 = 0.5 * NOTEFREQUENCY * 48000 (=sample rate)
-#define NOTEAMPLITUDE 500.0		//amplitude of the saw wave
+#define NOTEFREQUENCY 0.015f		//frequency of saw wave used by the benchmark: f0 = 0.5 * NOTEFREQUENCY * 48000 (=sample rate)
+#define NOTEAMPLITUDE 500.0f		//amplitude of the saw wave
+#define SOUND_DURATION_MS 500
+#define SAMPLE_RATE 48000
+#define SOUND_SAMPLES (SAMPLE_RATE / 1000 * SOUND_DURATION_MS)
+#define CHIME_MAX_SAMPLES 400		//longest loop kept, enough for any pitch where 48000 / gcd(48000, f) <= 400
+
+#define SOUND_MAX_VOICES 4			//chimes that can play over each other
+#define SOUND_QUEUE_LENGTH 8
+#define SOUND_HALF_FRAMES 256		//L/R frames mixed per DMA half, about 5 ms
+#define SOUND_BUFFER_SIZE (SOUND_HALF_FRAMES * 2 * 2)
+#define SOUND_SILENT_HALVES 2		//halves of silence sent before the DMA is paused
 
+#define SOUND_DMA_STREAM DMA1_Stream5	//SPI3_TX
+#define SOUND_DMA_CHANNEL DMA_Channel_0
+#define SOUND_DMA_IRQn DMA1_Stream5_IRQn
+#define SOUND_DMA_IRQ_PRIORITY (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1)
+
+/*
+ * One loop of a chime, rendered once at boot. The loop covers a whole number of
+ * saw wave cycles so it can be replayed back to back without a click.
+ */
 typedef struct {
-	float tabs[8];
-	float params[8];
-	uint8_t currIndex;
-} fir_8;
+	int16_t samples[CHIME_MAX_SAMPLES];
+	uint32_t length;
+} Chime;
 
-// struct to initialize GPIO pins
-GPIO_InitTypeDef GPIO_InitStructure;
+typedef struct {
+	const Chime *chime;
+	uint32_t position;
+	uint32_t remaining;	//frames left to play, 0 when the voice is free
+} Voice;
 
-volatile uint32_t sampleCounter = 0;
-volatile int16_t sample = 0;
+static Chime chimes[LEDn];
+static Voice voices[SOUND_MAX_VOICES];
 
-double sawWave = 0.0;
+static int16_t soundBuffer[SOUND_BUFFER_SIZE];
+static volatile uint32_t freeHalf;
 
-double filteredSaw = 0.0;
+static xQueueHandle xSoundQueue;
+static TaskHandle_t xSoundTask;
 
-float updateFilter(fir_8*, float);
-void initFilter(fir_8*);
+#ifdef SOUND_BENCHMARK
+#define BENCHMARK_SAMPLES 4800
 
-static fir_8 filt;
+// Set a break point at the end of benchmarkSound to read these
+uint32_t referenceCyclesPerSample = 0;
+uint32_t synthCyclesPerSample = 0;
+uint32_t synthMaxError = 0;
+
+/*
+ * The original double precision saw wave and per sample FIR, kept so the
+ * block renderer can be timed against it on the board. Tools/synth_check.c does
+ * the same comparison on the host.
+ */
+typedef struct {
+	float tabs[8];
+	float params[8];
+	uint8_t currIndex;
+} fir_8;
 
 static void initFilter(fir_8* theFilter) {
 	uint8_t i;
 
 	theFilter->currIndex = 0;
-	sampleCounter = 0;
 
 	for (i=0; i<8; i++)
 		theFilter->tabs[i] = 0.0;
@@ -69,35 +114,271 @@ static float updateFilter(fir_8* filt, float val) {
 	return outval;
 }
 
+static void renderReference(int16_t *out, uint32_t count) {
+	static fir_8 filt;
+	double sawWave = 0.0;
+	double filteredSaw;
+	uint32_t i;
+
+	initFilter(&filt);
+	for(i = 0; i < count; i++) {
+		sawWave += (double)NOTEFREQUENCY;
+		if (sawWave > 1.0) {
+			sawWave -= 2.0;
+		}
+		filteredSaw = updateFilter(&filt, sawWave);
+		out[i] = (int16_t)(NOTEAMPLITUDE*filteredSaw);
+	}
+}
+
+/*
+ * Time both renderers with the DWT cycle counter and find the largest difference
+ * between the fixed point block renderer and the original.
+ */
+static void benchmarkSound() {
+	static Synth synth;
+	static int16_t reference[BENCHMARK_SAMPLES];
+	static int16_t rendered[BENCHMARK_SAMPLES];
+	uint32_t start;
+	uint32_t error;
+	uint32_t i;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	start = DWT->CYCCNT;
+	renderReference(reference, BENCHMARK_SAMPLES);
+	referenceCyclesPerSample = (DWT->CYCCNT - start) / BENCHMARK_SAMPLES;
+
+	initSynth(&synth, NOTEFREQUENCY, NOTEAMPLITUDE);
+	start = DWT->CYCCNT;
+	renderSynth(&synth, rendered, BENCHMARK_SAMPLES);
+	synthCyclesPerSample = (DWT->CYCCNT - start) / BENCHMARK_SAMPLES;
+
+	synthMaxError = 0;
+	for(i = 0; i < BENCHMARK_SAMPLES; i++) {
+		error = reference[i] > rendered[i] ? reference[i] - rendered[i] : rendered[i] - reference[i];
+		if(error > synthMaxError) {
+			synthMaxError = error;
+		}
+	}
+}
+#endif
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+	uint32_t remainder;
+	
+	while(b != 0) {
+		remainder = a % b;
+		a = b;
+		b = remainder;
+	}
+	return a;
+}
+
+/*
+ * Render one loop of a saw wave at frequency Hz through the filter. A loop is the
+ * shortest run of samples holding a whole number of cycles. The first loop is
+ * thrown away so the filter history at the start of the table matches its end.
+ */
+static void loadChime(Chime *chime, uint32_t frequency) {
+	Synth synth;
+	
+	chime->length = SAMPLE_RATE / greatestCommonDivisor(SAMPLE_RATE, frequency);
+	if(chime->length > CHIME_MAX_SAMPLES) {
+		chime->length = CHIME_MAX_SAMPLES;	// loops with a click, pick a friendlier pitch
+	}
+	
+	initSynth(&synth, 2.0f * frequency / SAMPLE_RATE, NOTEAMPLITUDE);
+	renderSynth(&synth, chime->samples, chime->length);
+	renderSynth(&synth, chime->samples, chime->length);
+}
+
+/*
+ * Feed the I2S transmit register from soundBuffer in a loop. The DMA interrupts
+ * at the half way point and at the end so one half can be mixed while the other plays.
+ */
+static void initializeSoundDMA() {
+	DMA_InitTypeDef DMA_InitStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+
+	DMA_DeInit(SOUND_DMA_STREAM);
+	DMA_StructInit(&DMA_InitStructure);
+	DMA_InitStructure.DMA_Channel = SOUND_DMA_CHANNEL;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&CODEC_I2S->DR;
+	DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)soundBuffer;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+	DMA_InitStructure.DMA_BufferSize = SOUND_BUFFER_SIZE;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+	DMA_Init(SOUND_DMA_STREAM, &DMA_InitStructure);
+	DMA_ITConfig(SOUND_DMA_STREAM, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+	NVIC_InitStructure.NVIC_IRQChannel = SOUND_DMA_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = SOUND_DMA_IRQ_PRIORITY;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&NVIC_InitStructure);
+
+	SPI_I2S_DMACmd(CODEC_I2S, SPI_I2S_DMAReq_Tx, ENABLE);
+}
+
 void initializeSound() {
+	uint32_t i;
+	
 	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOC, ENABLE);
 	codec_init();
+	initializeSoundDMA();
+	
+	for(i = 0; i < LEDn; i++) {
+		loadChime(&chimes[i], getCoffeeChimeFrequency((Coffee)i));
+	}
+#ifdef SOUND_BENCHMARK
+	benchmarkSound();
+#endif
+	
+	xSoundQueue = xQueueCreate(SOUND_QUEUE_LENGTH, sizeof(Coffee));
+}
+
+/*
+ * Ask the sound service to play a Coffee type's chime. This never waits on the
+ * codec, so completions don't hold each other up.
+ */
+void playSound(Coffee coffee) {
+	xQueueSend(xSoundQueue, &coffee, 0);
+}
+
+/*
+ * Give a chime a voice. If every voice is busy the one closest to finishing
+ * is cut short.
+ */
+static void startVoice(Coffee coffee) {
+	Voice *voice = &voices[0];
+	uint32_t i;
+
+	for(i = 1; i < SOUND_MAX_VOICES; i++) {
+		if(voices[i].remaining < voice->remaining) {
+			voice = &voices[i];
+		}
+	}
+
+	voice->chime = &chimes[coffee];
+	voice->position = 0;
+	voice->remaining = SOUND_SAMPLES;
 }
 
-void prepareSound() {
+/*
+ * Mix every active voice into one half of soundBuffer. Returns the number of
+ * voices still playing.
+ */
+static uint32_t mixVoices(int16_t *out) {
+	int32_t mixed;
+	uint32_t frame;
+	uint32_t i;
+	uint32_t active = 0;
+	Voice *voice;
+
+	for(frame = 0; frame < SOUND_HALF_FRAMES; frame++) {
+		mixed = 0;
+		for(i = 0; i < SOUND_MAX_VOICES; i++) {
+			voice = &voices[i];
+			if(voice->remaining == 0) {
+				continue;
+			}
+			mixed += voice->chime->samples[voice->position];
+			if(++voice->position == voice->chime->length) {
+				voice->position = 0;
+			}
+			voice->remaining--;
+		}
+
+		if(mixed > INT16_MAX) {
+			mixed = INT16_MAX;
+		} else if(mixed < INT16_MIN) {
+			mixed = INT16_MIN;
+		}
+
+		//write each sample twice to insure that L & R ch. have the same sample value
+		out[frame * 2] = (int16_t)mixed;
+		out[frame * 2 + 1] = (int16_t)mixed;
+	}
+
+	for(i = 0; i < SOUND_MAX_VOICES; i++) {
+		if(voices[i].remaining > 0) {
+			active++;
+		}
+	}
+	return active;
+}
+
+/*
+ * Owns the codec. It is powered up once here and left running; play requests
+ * come in through xSoundQueue and are mixed into a single DMA stream. The DMA is
+ * paused once everything has finished and restarted by the next request.
+ */
+void vSoundService(void *pvParameters) {
+	Coffee coffee;
+	uint32_t silentHalves;
+
+	xSoundTask = xTaskGetCurrentTaskHandle();
 	codec_ctrl_init();
-	initFilter(&filt);
 	I2S_Cmd(CODEC_I2S, ENABLE);
-}
 
-void playSound() {
-	int i;
-			for(i = 0; i < 3600000; i++) {
-				if (SPI_I2S_GetFlagStatus(CODEC_I2S, SPI_I2S_FLAG_TXE)) {
-					SPI_I2S_SendData(CODEC_I2S, sample);
-
-					//only update on every second sample to insure that L & R ch. have the same sample value
-					if (sampleCounter & 0x00000001) {	
-						sawWave += NOTEFREQUENCY;
-    
-						if (sawWave > 1.0) {
-							sawWave -= 2.0;
-						}
-						filteredSaw = updateFilter(&filt, sawWave);
-						sample = (int16_t)(NOTEAMPLITUDE*filteredSaw);
-					}
-					sampleCounter++;
-				}
+	for(;;) {
+		// Idle: nothing is streaming, so wait for a request
+		xQueueReceive(xSoundQueue, &coffee, portMAX_DELAY);
+		startVoice(coffee);
+
+		mixVoices(soundBuffer);
+		mixVoices(&soundBuffer[SOUND_HALF_FRAMES * 2]);
+		silentHalves = 0;
+
+		// Disabling the stream sets its transfer complete flag, so the last pause left a
+		// flag and a notification behind that would have the first half overwritten
+		DMA_ClearFlag(SOUND_DMA_STREAM, DMA_FLAG_HTIF5 | DMA_FLAG_TCIF5);
+		ulTaskNotifyTake(pdTRUE, 0);
+		DMA_SetCurrDataCounter(SOUND_DMA_STREAM, SOUND_BUFFER_SIZE);
+		DMA_Cmd(SOUND_DMA_STREAM, ENABLE);
+
+		// Streaming: refill whichever half the DMA just finished with
+		while(silentHalves < SOUND_SILENT_HALVES) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+			while(xQueueReceive(xSoundQueue, &coffee, 0) == pdTRUE) {
+				startVoice(coffee);
+			}
+
+			if(mixVoices(&soundBuffer[freeHalf * SOUND_HALF_FRAMES * 2]) > 0) {
+				silentHalves = 0;
+			} else {
+				silentHalves++;
 			}
-			GPIO_ResetBits(GPIOD, CODEC_RESET_PIN);		
+		}
+
+		DMA_Cmd(SOUND_DMA_STREAM, DISABLE);
+		while(DMA_GetCmdStatus(SOUND_DMA_STREAM) == ENABLE);
+	}
+}
+
+void DMA1_Stream5_IRQHandler(void) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if(DMA_GetITStatus(SOUND_DMA_STREAM, DMA_IT_HTIF5)) {
+		DMA_ClearITPendingBit(SOUND_DMA_STREAM, DMA_IT_HTIF5);
+		freeHalf = 0;
+	}
+	if(DMA_GetITStatus(SOUND_DMA_STREAM, DMA_IT_TCIF5)) {
+		DMA_ClearITPendingBit(SOUND_DMA_STREAM, DMA_IT_TCIF5);
+		freeHalf = 1;
+	}
+
+	vTaskNotifyGiveFromISR(xSoundTask, &xHigherPriorityTaskWoken);
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
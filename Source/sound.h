@@ -1,8 +1,10 @@
 #ifndef _SOUND_H
 #define _SOUND_H
 
+#include "coffee.h"
+
 void initializeSound(void);
-void prepareSound(void);
-void playSound(void);
+void playSound(Coffee);
+void vSoundService(void *);
 
 #endif
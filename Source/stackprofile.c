@@ -0,0 +1,83 @@
+#include "stackprofile.h"
+
+#include "timers.h"
+
+#if configSTACK_PROFILING == 1
+
+// Extra words kept on top of the deepest use we saw. The percentage covers code
+// paths the profiling run never hit, the constant covers an exception frame.
+#define STACK_MARGIN_PERCENT 25
+#define STACK_MARGIN_WORDS 16
+#define STACK_PROFILE_DELAY 1000
+
+StackProfile stackProfiles[STACK_PROFILE_MAX_TASKS];
+uint32_t stackProfileCount = 0;
+
+/*
+ * Register a task so the profiler knows how many words it was created with.
+ */
+void profileTaskStack(TaskHandle_t handle, uint16_t allocated) {
+	StackProfile *profile;
+	
+	if(handle == NULL || stackProfileCount >= STACK_PROFILE_MAX_TASKS) {
+		return;
+	}
+	
+	profile = &stackProfiles[stackProfileCount++];
+	profile->name = pcTaskGetName(handle);
+	profile->handle = handle;
+	profile->allocated = allocated;
+	profile->minFree = allocated;
+	profile->recommended = allocated;
+}
+
+/*
+ * Round the deepest stack use up by the margin and to a multiple of 8 words
+ * so the stack stays 8 byte aligned.
+ */
+static uint16_t recommendStackSize(uint16_t used) {
+	uint32_t words = used + (used * STACK_MARGIN_PERCENT) / 100 + STACK_MARGIN_WORDS;
+	
+	return (uint16_t)((words + 7) & ~7UL);
+}
+
+/*
+ * Sample the high water mark of every registered task. Let the system run through
+ * its scenarios, then set a break point here and read stackProfiles[] to get the
+ * recommended size for each task.
+ */
+void vStackProfiler(void *pvParameters) {
+	uint32_t i;
+	uint16_t highWaterMark;
+	
+	// The kernel creates these before the scheduler starts, so they can only be
+	// registered from a running task.
+	profileTaskStack(xTaskGetIdleTaskHandle(), configMINIMAL_STACK_SIZE);
+	profileTaskStack(xTimerGetTimerDaemonTaskHandle(), configTIMER_TASK_STACK_DEPTH);
+	
+	for(;;) {
+		for(i = 0; i < stackProfileCount; i++) {
+			highWaterMark = (uint16_t)uxTaskGetStackHighWaterMark(stackProfiles[i].handle);
+			
+			if(highWaterMark < stackProfiles[i].minFree) {
+				stackProfiles[i].minFree = highWaterMark;
+				stackProfiles[i].recommended = recommendStackSize(stackProfiles[i].allocated - highWaterMark);
+			}
+		}
+		vTaskDelay(STACK_PROFILE_DELAY / portTICK_RATE_MS);
+	}
+}
+
+/*
+ * Called by the kernel on a context switch out of a task that has written past
+ * the end of its stack. Keep the offender's name around for the debugger and stop.
+ */
+void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName) {
+	volatile const char *overflowedTask = pcTaskName;
+	
+	(void)overflowedTask;
+	taskDISABLE_INTERRUPTS();
+	for(;;);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _STACKPROFILE_H
+#define _STACKPROFILE_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define STACK_PROFILE_MAX_TASKS 12
+
+typedef struct {
+	const char *name;
+	TaskHandle_t handle;
+	uint16_t allocated;		// words given to xTaskCreate
+	uint16_t minFree;		// lowest high water mark seen, in words
+	uint16_t recommended;	// words to use instead of allocated
+} StackProfile;
+
+#if configSTACK_PROFILING == 1
+extern StackProfile stackProfiles[STACK_PROFILE_MAX_TASKS];
+extern uint32_t stackProfileCount;
+
+void profileTaskStack(TaskHandle_t, uint16_t);
+void vStackProfiler(void *);
+#else
+#define profileTaskStack(handle, allocated)
+#endif
+
+#endif
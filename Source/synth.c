@@ -0,0 +1,109 @@
+#include "synth.h"
+
+#if defined(__ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+#include "stm32f4xx.h"
+#define SYNTH_USE_SIMD
+#endif
+
+#define PHASE_SCALE 2147483648.0	// 2^31, one unit of saw amplitude in phase steps
+#define ACC_SHIFT 29				// Q14 samples times Q15 taps
+
+/*
+ * Filter taps ordered oldest input to newest input. The old circular buffer
+ * in sound.c lined params[] up against its samples rotated by one slot, so the
+ * taps are {0.01, 0.05, 0.12, 0.32, 0.32, 0.12, 0.05, 0.01} in that same order
+ * to keep the chime sounding as it did:
+ *
+ *   taps for x[0..7] = {0.05, 0.12, 0.32, 0.32, 0.12, 0.05, 0.01, 0.01}
+ *
+ * Taps 0-5 are symmetric and taps 6-7 are equal, so the inputs sharing a tap are
+ * added first and only 4 multiplies are needed. The Q15 taps below sum to exactly
+ * 1.0, and the samples are kept in Q14 so a pair sum still fits in 16 bits.
+ */
+#define TAP_005 1638
+#define TAP_012 3932
+#define TAP_032 10486
+#define TAP_001 328
+
+// Tap pairs packed low half first, the way SMLAD multiplies them
+#define PACK(low, high) (((uint32_t)(uint16_t)(low)) | ((uint32_t)(uint16_t)(high) << 16))
+
+static const uint32_t outerTaps = PACK(TAP_005, TAP_012);
+static const uint32_t innerTaps = PACK(TAP_032, TAP_001);
+
+#ifdef SYNTH_USE_SIMD
+#define smlad(x, y, acc) ((int32_t)__SMLAD((x), (y), (uint32_t)(acc)))
+#else
+/*
+ * Portable equivalent of the M4's SMLAD: acc plus the products of the low
+ * halves and of the high halves.
+ */
+static int32_t smlad(uint32_t x, uint32_t y, int32_t acc) {
+	return acc + (int16_t)x * (int16_t)y + (int16_t)(x >> 16) * (int16_t)(y >> 16);
+}
+#endif
+
+/*
+ * noteFrequency is the saw wave step per sample: f0 = 0.5 * noteFrequency * 48000.
+ * The phase step is rounded up so the saw wraps on the same sample that the old
+ * double precision accumulator did when it landed on 1.0.
+ */
+void initSynth(Synth *synth, float noteFrequency, float amplitude) {
+	uint32_t i;
+	
+	for(i = 0; i < SYNTH_TAPS - 1 + SYNTH_BLOCK_SIZE; i++) {
+		synth->state[i] = 0;
+	}
+	
+	synth->phase = 0;
+	synth->step = (uint32_t)(noteFrequency * PHASE_SCALE + 1.0);
+	synth->amplitude = (int32_t)amplitude;
+}
+
+/*
+ * Filter up to SYNTH_BLOCK_SIZE new samples that have been written after the history
+ * in synth->state, then slide the newest 7 inputs down to make room for the next block.
+ */
+static void filterBlock(Synth *synth, int16_t *out, uint32_t count) {
+	uint32_t i;
+	int32_t acc;
+	const int16_t *x;
+	
+	for(i = 0; i < count; i++) {
+		x = &synth->state[i];
+		acc = smlad(PACK(x[0] + x[5], x[1] + x[4]), outerTaps, 0);
+		acc = smlad(PACK(x[2] + x[3], x[6] + x[7]), innerTaps, acc);
+		
+		// Divide rather than shift so the result truncates toward zero like the old float cast
+		out[i] = (int16_t)(((int64_t)acc * synth->amplitude) / (1L << ACC_SHIFT));
+	}
+	
+	for(i = 0; i < SYNTH_TAPS - 1; i++) {
+		synth->state[i] = synth->state[count + i];
+	}
+}
+
+/*
+ * Render count mono samples of the filtered saw wave into out, SYNTH_BLOCK_SIZE
+ * samples at a time.
+ */
+void renderSynth(Synth *synth, int16_t *out, uint32_t count) {
+	uint32_t i, blockSize;
+	uint32_t phase = synth->phase;
+	
+	while(count > 0) {
+		blockSize = count < SYNTH_BLOCK_SIZE ? count : SYNTH_BLOCK_SIZE;
+		
+		// Wrapping past the top of the phase range is the saw wave's drop from 1.0 to -1.0
+		for(i = 0; i < blockSize; i++) {
+			phase += synth->step;
+			synth->state[SYNTH_TAPS - 1 + i] = (int16_t)((int32_t)phase >> 17);
+		}
+		
+		filterBlock(synth, out, blockSize);
+		out += blockSize;
+		count -= blockSize;
+	}
+	
+	synth->phase = phase;
+}
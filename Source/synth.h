@@ -0,0 +1,24 @@
+#ifndef _SYNTH_H
+#define _SYNTH_H
+
+#include <stdint.h>
+
+#define SYNTH_TAPS 8
+#define SYNTH_BLOCK_SIZE 32
+
+/*
+ * Saw wave oscillator followed by the 8 tap low pass FIR used for the chime.
+ * The oscillator is an integer phase accumulator so it never drifts, and the
+ * filter runs in fixed point so it can use the M4's dual 16 bit MAC.
+ */
+typedef struct {
+	int16_t state[SYNTH_TAPS - 1 + SYNTH_BLOCK_SIZE];	// Q14 inputs: last 7 followed by the block being filtered
+	uint32_t phase;		// saw wave position, the full 32 bit range spans -1.0 to 1.0
+	uint32_t step;
+	int32_t amplitude;
+} Synth;
+
+void initSynth(Synth *, float, float);
+void renderSynth(Synth *, int16_t *, uint32_t);
+
+#endif
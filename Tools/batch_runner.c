@@ -0,0 +1,691 @@
+/*
+ * Host side model of the board's scheduler. Runs scenario files under every
+ * scheduling policy in main.c that they ask for, spread over one thread per core,
+ * and prints a table of missed deadlines and brew switches.
+ *
+ * Like vScheduler, a scheduling pass happens on every release, when the brew
+ * should be done, and otherwise SCHEDULER_DELAY after the last pass. Fixed
+ * priorities are the catalog's, and
+ * Audsley's come from priority.c run on the scenario's catalog.
+ *
+ * A scenario file has one statement per line, and # starts a comment. Each name
+ * line starts a new scenario, so one file can hold as many as it likes.
+ *   name <text>
+ *   duration <ms>			how long to run after the first release, like RUN_TIME (100000)
+ *   policy all|<policy>...	main.c's option names, e.g. EARLIEST_DEADLINE_FIRST (all)
+ *   coffee <coffee> [brew <ms>] [period <ms>] [deadline <ms>] [priority <n>]
+ *							change a coffee from the coffee.c catalog
+ *   threshold <ms>			LAXITY_THRESHOLD for LEAST_LAXITY_FIRST_THRESHOLD (2000)
+ *   progress exact|second	whether the scheduler sees remainingWork to the ms, or only
+ *							drop once per whole second brewed like vBrewCoffeeType
+ *							used to count it (exact)
+ *   at <ms> <command>		a serial command from input.c, applied <ms> after the run starts
+ * The commands are the ones vSerialCommands takes, with the same meaning:
+ *   press single|double|long
+ *   all [+seconds]
+ *   start <coffee> [+seconds]
+ *   order <count> <coffee> [+seconds]
+ * Like on the board, a single press moves the selection on from espresso past the
+ * coffees already started, a long press starts the selected one, and an order
+ * releases one-off jobs with the coffee's usual deadline. A scenario whose
+ * coffees are never started has nothing to run and is reported as such.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/batch_runner.c Source/job.c Source/coffee.c Source/priority.c -pthread -o batch_runner && ./batch_runner Tools/scenarios/[a-z]*.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "coffee.h"
+#include "job.h"
+#include "input.h"
+#include "priority.h"
+
+// The same values as main.c
+#define SCHEDULER_DELAY 1000
+#define LAXITY_THRESHOLD 2000
+#define ROUND_ROBIN_QUANTUM 1000
+#define STRIDE_SCALE 100
+#define RUN_TIME 100000
+
+#define MAX_SCENARIOS 1024
+#define MAX_EVENTS 64
+#define MAX_NAME 64
+#define MAX_LINE 256
+#define MAX_THREADS 64
+
+typedef enum {
+	FIXED_PRIORITY,
+	EARLIEST_DEADLINE_FIRST,
+	LEAST_LAXITY_FIRST,
+	LEAST_LAXITY_FIRST_THRESHOLD,
+	RATE_MONOTONIC,
+	DEADLINE_MONOTONIC,
+	AUDSLEY,
+	ROUND_ROBIN,
+	STRIDE,
+	POLICY_COUNT
+} Policy;
+
+static const char *POLICY_OPTIONS[] = {"FIXED_PRIORITY", "EARLIEST_DEADLINE_FIRST", "LEAST_LAXITY_FIRST",
+	"LEAST_LAXITY_FIRST_THRESHOLD", "RATE_MONOTONIC", "DEADLINE_MONOTONIC", "AUDSLEY", "ROUND_ROBIN", "STRIDE"};
+static const char *POLICY_COLUMNS[] = {"FP", "EDF", "LLF", "LLF-T", "RM", "DM", "Audsley", "RR", "Stride"};
+
+typedef enum {
+	EXACT_PROGRESS,
+	SECOND_PROGRESS
+} Progress;
+
+typedef struct {
+	int32_t at;			// ms from the start of the run
+	InputEventType type;
+	Coffee coffee;
+	uint32_t count;
+} ScenarioEvent;
+
+typedef struct {
+	char name[MAX_NAME];
+	int32_t runTime;			// ms after the first release
+	uint32_t policies;			// bit mask of Policy
+	BrewLoad catalog[LEDn];
+	int32_t priorities[LEDn];	// fixed priorities, the higher the sooner
+	int32_t laxityThreshold;
+	Progress progress;
+	ScenarioEvent events[MAX_EVENTS];
+	uint32_t eventCount;
+} Scenario;
+
+typedef struct {
+	uint32_t ran;				// 0 if nothing was ever released
+	uint32_t missed;
+	uint32_t switches;
+} SimResult;
+
+// What one run of a scenario remembers between passes
+typedef struct {
+	const Scenario *scenario;
+	Policy policy;
+	JobPool pool;
+	JobRing rings[LEDn];
+	int32_t startTime[LEDn];	// -1 until the coffee is started
+	int32_t audsleyPriorities[LEDn];
+	Coffee selected;
+	Coffee lastBrewed;
+	int32_t brewingSince;
+	int32_t stridePass[LEDn];
+	int32_t strideChargedAt;
+} Run;
+
+static Scenario scenarios[MAX_SCENARIOS];
+static uint32_t scenarioCount;
+static SimResult results[MAX_SCENARIOS][POLICY_COUNT];
+
+static pthread_mutex_t nextMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t nextItem;
+
+static int32_t getPriority(const Scenario *scenario, Coffee type) {
+	return type == DEFAULT_COFFEE ? 0 : scenario->priorities[type];
+}
+
+/*
+ * The remaining work of a job as the scheduler sees it.
+ */
+static int32_t visibleWork(const Scenario *scenario, Coffee type, Job *job) {
+	int32_t done = (int32_t)scenario->catalog[type].work - job->remainingWork;
+
+	if(scenario->progress == SECOND_PROGRESS) {
+		done -= done % 1000;
+	}
+	return (int32_t)scenario->catalog[type].work - done;
+}
+
+/*
+ * Move the stride passes on for the time the brewing coffee has brewed and keep them
+ * small, like schedule_Stride.
+ */
+static void chargeStride(Run *run, Coffee brewing, int32_t t) {
+	const BrewLoad *catalog = run->scenario->catalog;
+	int32_t minPass = 0x7FFFFFFF;
+	uint32_t i;
+
+	if(brewing != DEFAULT_COFFEE) {
+		run->stridePass[brewing] += STRIDE_SCALE * (int32_t)catalog[brewing].period / (int32_t)catalog[brewing].work *
+			(t - run->strideChargedAt);
+	}
+	run->strideChargedAt = t;
+
+	for(i = 0; i < LEDn; i++) {
+		if(run->rings[i].count > 0 && run->stridePass[i] < minPass) {
+			minPass = run->stridePass[i];
+		}
+	}
+	if(minPass == 0x7FFFFFFF) {
+		return;
+	}
+	for(i = 0; i < LEDn; i++) {
+		run->stridePass[i] -= minPass;
+		if(run->stridePass[i] < 0) {
+			run->stridePass[i] = 0;
+		}
+	}
+}
+
+/*
+ * One scheduling pass: the same priorities and tie breaking as the schedule_*
+ * functions and getHighestPriorityTask.
+ */
+static Coffee selectCoffee(Run *run, Coffee brewing, int32_t t) {
+	const Scenario *scenario = run->scenario;
+	Coffee selected = DEFAULT_COFFEE;
+	int32_t maxPriority = 0x80000000;
+	int32_t priority;
+	Job *job;
+	uint32_t i;
+
+	if(run->policy == STRIDE) {
+		chargeStride(run, brewing, t);
+	}
+
+	for(i = 0; i < LEDn; i++) {
+		job = peekJob(&run->rings[i]);
+		if(job == NULL) {
+			continue;
+		}
+
+		switch(run->policy) {
+			case FIXED_PRIORITY:
+				priority = scenario->priorities[i];
+				break;
+			case EARLIEST_DEADLINE_FIRST:
+				priority = -job->deadline;
+				break;
+			case LEAST_LAXITY_FIRST:
+			case LEAST_LAXITY_FIRST_THRESHOLD:
+				priority = -(job->deadline - visibleWork(scenario, (Coffee)i, job));
+				if(run->policy == LEAST_LAXITY_FIRST_THRESHOLD && i == brewing) {
+					priority += scenario->laxityThreshold;
+				}
+				break;
+			case RATE_MONOTONIC:
+				priority = -(int32_t)scenario->catalog[i].period;
+				break;
+			case DEADLINE_MONOTONIC:
+				priority = -(int32_t)scenario->catalog[i].deadline;
+				break;
+			case AUDSLEY:
+				priority = run->audsleyPriorities[i];
+				break;
+			case ROUND_ROBIN:
+				if(i == brewing && t - run->brewingSince < ROUND_ROBIN_QUANTUM) {
+					priority = 1;
+				} else {
+					priority = -(((int32_t)i + 2 * LEDn - (int32_t)run->lastBrewed - 1) % LEDn);
+				}
+				break;
+			default:
+				priority = -run->stridePass[i];
+				break;
+		}
+
+		if(priority > maxPriority ||
+				(priority == maxPriority && getPriority(scenario, (Coffee)i) > getPriority(scenario, selected))) {
+			maxPriority = priority;
+			selected = (Coffee)i;
+		}
+	}
+	return selected;
+}
+
+/*
+ * releaseCoffee: a job of the coffee released at t with the coffee's usual deadline.
+ * Returns 0 if its ring was full, which the board counts as a missed deadline.
+ */
+static uint32_t releaseCoffee(Run *run, Coffee type, int32_t t) {
+	const BrewLoad *entry = &run->scenario->catalog[type];
+
+	return pushJob(&run->rings[type], t, t + (int32_t)entry->deadline, (int32_t)entry->work);
+}
+
+/*
+ * applyInputEvent, with startCoffeeType releasing the coffee's first job now.
+ * Returns how many releases found their ring full.
+ */
+static uint32_t applyEvent(Run *run, const ScenarioEvent *event, int32_t t) {
+	uint32_t full = 0;
+	uint32_t count;
+	uint32_t i;
+
+	switch(event->type) {
+		case INPUT_SINGLE_PRESS:
+			// selectNextCoffee skips the coffees already started
+			for(i = 0; i < LEDn; i++) {
+				run->selected = (Coffee)((run->selected + 1) % LEDn);
+				if(run->startTime[run->selected] < 0) {
+					break;
+				}
+			}
+			return 0;
+		case INPUT_LONG_PRESS:
+		case INPUT_START:
+			i = event->type == INPUT_START ? event->coffee : run->selected;
+			if(run->startTime[i] < 0) {
+				run->startTime[i] = t;
+				full += !releaseCoffee(run, (Coffee)i, t);
+			}
+			return full;
+		case INPUT_DOUBLE_PRESS:
+		case INPUT_START_ALL:
+			for(i = 0; i < LEDn; i++) {
+				if(run->startTime[i] < 0) {
+					run->startTime[i] = t;
+					full += !releaseCoffee(run, (Coffee)i, t);
+				}
+			}
+			return full;
+		case INPUT_ORDER:
+			for(count = 0; count < event->count; count++) {
+				full += !releaseCoffee(run, event->coffee, t);
+			}
+			return full;
+	}
+	return 0;
+}
+
+/*
+ * Like vScheduler, a scheduling pass happens on every release, when the brew should
+ * be done, and otherwise SCHEDULER_DELAY after the last pass.
+ */
+static SimResult simulate(const Scenario *scenario, Policy policy) {
+	static const Run EMPTY_RUN;
+	Run run = EMPTY_RUN;
+	Coffee brewing = DEFAULT_COFFEE;
+	Coffee selected;
+	int32_t firstRelease = -1;
+	int32_t lastEvent = 0;
+	int32_t nextPass = 0;
+	SimResult result = {0};
+	uint32_t nextEvent = 0;
+	uint32_t released;
+	Job *job;
+	int32_t t;
+	uint32_t i;
+
+	run.scenario = scenario;
+	run.policy = policy;
+	run.selected = ESPRESSO;	// main.c's INITIAL_COFFEE
+	run.lastBrewed = DEFAULT_COFFEE;
+	initJobPool(&run.pool);
+	for(i = 0; i < LEDn; i++) {
+		initJobRing(&run.rings[i], &run.pool);
+		run.startTime[i] = -1;
+	}
+	if(policy == AUDSLEY) {
+		assignAudsleyPriorities(scenario->catalog, LEDn, run.audsleyPriorities);
+	}
+	if(scenario->eventCount > 0) {
+		lastEvent = scenario->events[scenario->eventCount - 1].at;
+	}
+
+	for(t = 0; firstRelease == -1 ? t <= lastEvent : t - firstRelease <= scenario->runTime; t++) {
+		released = 0;
+		for(; nextEvent < scenario->eventCount && scenario->events[nextEvent].at <= t; nextEvent++) {
+			result.missed += applyEvent(&run, &scenario->events[nextEvent], t);
+			released = 1;
+		}
+		for(i = 0; i < LEDn; i++) {
+			if(run.startTime[i] >= 0 && t > run.startTime[i] &&
+					(t - run.startTime[i]) % (int32_t)scenario->catalog[i].period == 0) {
+				result.missed += !releaseCoffee(&run, (Coffee)i, t);
+				released = 1;
+			}
+		}
+		for(i = 0; i < LEDn && firstRelease == -1; i++) {
+			if(run.rings[i].count > 0) {
+				firstRelease = t;
+			}
+		}
+
+		if(released || t >= nextPass) {
+			selected = selectCoffee(&run, brewing, t);
+			if(selected != brewing && selected != DEFAULT_COFFEE) {
+				if(brewing != DEFAULT_COFFEE) {
+					result.switches++;
+				}
+				run.lastBrewed = selected;
+				run.brewingSince = t;
+				brewing = selected;
+			}
+			nextPass = t + SCHEDULER_DELAY;
+			if(brewing != DEFAULT_COFFEE && peekJob(&run.rings[brewing])->remainingWork < SCHEDULER_DELAY) {
+				nextPass = t + peekJob(&run.rings[brewing])->remainingWork;
+			}
+		}
+
+		if(brewing == DEFAULT_COFFEE) {
+			continue;
+		}
+
+		job = peekJob(&run.rings[brewing]);
+		job->remainingWork--;
+		if(job->remainingWork <= 0) {
+			if(t + 1 > job->deadline) {
+				result.missed++;
+			}
+			popJob(&run.rings[brewing]);
+			brewing = DEFAULT_COFFEE;
+		}
+	}
+	result.ran = firstRelease != -1;
+	return result;
+}
+
+static void *worker(void *unused) {
+	uint32_t item;
+
+	for(;;) {
+		pthread_mutex_lock(&nextMutex);
+		item = nextItem++;
+		pthread_mutex_unlock(&nextMutex);
+		if(item >= scenarioCount * POLICY_COUNT) {
+			return NULL;
+		}
+		if(scenarios[item / POLICY_COUNT].policies & (1 << (item % POLICY_COUNT))) {
+			results[item / POLICY_COUNT][item % POLICY_COUNT] =
+				simulate(&scenarios[item / POLICY_COUNT], (Policy)(item % POLICY_COUNT));
+		}
+	}
+}
+
+static Coffee parseCoffee(const char *name) {
+	uint32_t i;
+
+	for(i = 0; name != NULL && i < LEDn; i++) {
+		if(strcmp(name, getCoffeeName((Coffee)i)) == 0) {
+			return (Coffee)i;
+		}
+	}
+	return DEFAULT_COFFEE;
+}
+
+/*
+ * Parse a whole, non-negative number. Returns -1 if the token isn't one.
+ */
+static int32_t parseNumber(const char *token) {
+	char *end;
+	long value;
+
+	if(token == NULL || token[0] < '0' || token[0] > '9') {
+		return -1;
+	}
+	value = strtol(token, &end, 10);
+	return *end == '\0' && value <= 0x7FFFFFFF ? (int32_t)value : -1;
+}
+
+/*
+ * Parse an optional "+seconds" delay of up to SERIAL_MAX_DELAY, like input.c. Returns -1
+ * if the token is malformed or too long a delay.
+ */
+static int32_t parseDelay(const char *token) {
+	if(token == NULL) {
+		return 0;
+	}
+	if(token[0] != '+' || parseNumber(&token[1]) < 0 || parseNumber(&token[1]) > SERIAL_MAX_DELAY) {
+		return -1;
+	}
+	return parseNumber(&token[1]) * 1000;
+}
+
+/*
+ * The serial command in tokens, taken at the given time. Returns 0 if it doesn't parse.
+ */
+static uint32_t parseCommand(char **tokens, uint32_t tokenCount, int32_t at, ScenarioEvent *event) {
+	int32_t delay = 0;
+
+	event->coffee = DEFAULT_COFFEE;
+	event->count = 1;
+	if(strcmp(tokens[0], "press") == 0 && tokenCount == 2) {
+		if(strcmp(tokens[1], "single") == 0) {
+			event->type = INPUT_SINGLE_PRESS;
+		} else if(strcmp(tokens[1], "double") == 0) {
+			event->type = INPUT_DOUBLE_PRESS;
+		} else if(strcmp(tokens[1], "long") == 0) {
+			event->type = INPUT_LONG_PRESS;
+		} else {
+			return 0;
+		}
+	} else if(strcmp(tokens[0], "all") == 0 && tokenCount <= 2) {
+		event->type = INPUT_START_ALL;
+		delay = parseDelay(tokens[1]);
+	} else if(strcmp(tokens[0], "start") == 0 && tokenCount >= 2 && tokenCount <= 3) {
+		event->type = INPUT_START;
+		event->coffee = parseCoffee(tokens[1]);
+		delay = parseDelay(tokens[2]);
+		if(event->coffee == DEFAULT_COFFEE) {
+			return 0;
+		}
+	} else if(strcmp(tokens[0], "order") == 0 && tokenCount >= 3 && tokenCount <= 4) {
+		event->type = INPUT_ORDER;
+		event->count = (uint32_t)parseNumber(tokens[1]);
+		event->coffee = parseCoffee(tokens[2]);
+		delay = parseDelay(tokens[3]);
+		if(parseNumber(tokens[1]) <= 0 || parseNumber(tokens[1]) > JOB_RING_SIZE || event->coffee == DEFAULT_COFFEE) {
+			return 0;
+		}
+	} else {
+		return 0;
+	}
+	event->at = at + delay;
+	return delay >= 0;
+}
+
+/*
+ * A scenario with the coffee.c catalog, every policy, RUN_TIME, LAXITY_THRESHOLD and
+ * exact progress.
+ */
+static void initializeScenario(Scenario *scenario, const char *name) {
+	uint32_t i;
+
+	memset(scenario, 0, sizeof(*scenario));
+	snprintf(scenario->name, sizeof(scenario->name), "%s", name);
+	scenario->runTime = RUN_TIME;
+	scenario->policies = (1 << POLICY_COUNT) - 1;
+	scenario->laxityThreshold = LAXITY_THRESHOLD;
+	scenario->progress = EXACT_PROGRESS;
+	for(i = 0; i < LEDn; i++) {
+		scenario->catalog[i].work = getBrewDurations((Coffee)i) + getBrewOverrun((Coffee)i);
+		scenario->catalog[i].period = getCoffeePeriod((Coffee)i);
+		scenario->catalog[i].deadline = getCoffeeDeadline((Coffee)i);
+		scenario->priorities[i] = (int32_t)getCoffeePriority((Coffee)i);
+	}
+}
+
+/*
+ * Read every scenario in a file. Returns 0 and says why on the first line that
+ * doesn't parse.
+ */
+static uint32_t loadScenarios(const char *path) {
+	char line[MAX_LINE];
+	char *tokens[MAX_LINE / 2];
+	uint32_t tokenCount;
+	uint32_t lineNumber = 0;
+	Scenario *scenario = NULL;
+	ScenarioEvent event;
+	Coffee coffee;
+	int32_t value;
+	char *token;
+	FILE *file;
+	uint32_t i;
+	uint32_t j;
+
+	file = fopen(path, "r");
+	if(file == NULL) {
+		fprintf(stderr, "%s: can't open it\n", path);
+		return 0;
+	}
+
+	while(fgets(line, sizeof(line), file) != NULL) {
+		lineNumber++;
+		if(strchr(line, '#') != NULL) {
+			*strchr(line, '#') = '\0';
+		}
+		tokenCount = 0;
+		for(token = strtok(line, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+			tokens[tokenCount++] = token;
+		}
+		tokens[tokenCount] = NULL;
+		if(tokenCount == 0) {
+			continue;
+		}
+
+		if(strcmp(tokens[0], "name") == 0 && tokenCount >= 2) {
+			if(scenarioCount == MAX_SCENARIOS) {
+				fprintf(stderr, "%s:%u: more than %d scenarios\n", path, lineNumber, MAX_SCENARIOS);
+				break;
+			}
+			scenario = &scenarios[scenarioCount++];
+			initializeScenario(scenario, tokens[1]);
+			for(i = 2; i < tokenCount; i++) {
+				strncat(scenario->name, " ", sizeof(scenario->name) - strlen(scenario->name) - 1);
+				strncat(scenario->name, tokens[i], sizeof(scenario->name) - strlen(scenario->name) - 1);
+			}
+			continue;
+		}
+		if(scenario == NULL) {
+			fprintf(stderr, "%s:%u: a scenario has to start with a name line\n", path, lineNumber);
+			break;
+		}
+
+		if(strcmp(tokens[0], "duration") == 0 && tokenCount == 2 && parseNumber(tokens[1]) > 0) {
+			scenario->runTime = parseNumber(tokens[1]);
+		} else if(strcmp(tokens[0], "policy") == 0 && tokenCount >= 2) {
+			scenario->policies = 0;
+			for(i = 1; i < tokenCount; i++) {
+				for(j = 0; j < POLICY_COUNT; j++) {
+					if(strcmp(tokens[i], "all") == 0 || strcmp(tokens[i], POLICY_OPTIONS[j]) == 0) {
+						scenario->policies |= 1 << j;
+					}
+				}
+			}
+			if(scenario->policies == 0) {
+				fprintf(stderr, "%s:%u: no policy called %s\n", path, lineNumber, tokens[1]);
+				break;
+			}
+		} else if(strcmp(tokens[0], "coffee") == 0 && tokenCount >= 2 && tokenCount % 2 == 0 &&
+				parseCoffee(tokens[1]) != DEFAULT_COFFEE) {
+			coffee = parseCoffee(tokens[1]);
+			for(i = 2; i < tokenCount; i += 2) {
+				value = parseNumber(tokens[i + 1]);
+				if(value <= 0) {
+					break;
+				}
+				if(strcmp(tokens[i], "brew") == 0) {
+					scenario->catalog[coffee].work = (uint32_t)value;
+				} else if(strcmp(tokens[i], "period") == 0) {
+					scenario->catalog[coffee].period = (uint32_t)value;
+				} else if(strcmp(tokens[i], "deadline") == 0) {
+					scenario->catalog[coffee].deadline = (uint32_t)value;
+				} else if(strcmp(tokens[i], "priority") == 0) {
+					scenario->priorities[coffee] = value;
+				} else {
+					break;
+				}
+			}
+			if(i < tokenCount) {
+				fprintf(stderr, "%s:%u: expected brew, period, deadline or priority and a number above 0\n", path, lineNumber);
+				break;
+			}
+		} else if(strcmp(tokens[0], "threshold") == 0 && tokenCount == 2 && parseNumber(tokens[1]) >= 0) {
+			scenario->laxityThreshold = parseNumber(tokens[1]);
+		} else if(strcmp(tokens[0], "progress") == 0 && tokenCount == 2 &&
+				(strcmp(tokens[1], "exact") == 0 || strcmp(tokens[1], "second") == 0)) {
+			scenario->progress = strcmp(tokens[1], "second") == 0 ? SECOND_PROGRESS : EXACT_PROGRESS;
+		} else if(strcmp(tokens[0], "at") == 0 && tokenCount >= 3 && parseNumber(tokens[1]) >= 0) {
+			if(!parseCommand(&tokens[2], tokenCount - 2, parseNumber(tokens[1]), &event)) {
+				fprintf(stderr, "%s:%u: not a serial command input.c takes\n", path, lineNumber);
+				break;
+			}
+			if(scenario->eventCount == MAX_EVENTS) {
+				fprintf(stderr, "%s:%u: more than %d events\n", path, lineNumber, MAX_EVENTS);
+				break;
+			}
+			// Keep the events in time order, and in file order at the same time
+			for(i = scenario->eventCount; i > 0 && scenario->events[i - 1].at > event.at; i--) {
+				scenario->events[i] = scenario->events[i - 1];
+			}
+			scenario->events[i] = event;
+			scenario->eventCount++;
+		} else {
+			fprintf(stderr, "%s:%u: can't make sense of %s\n", path, lineNumber, tokens[0]);
+			break;
+		}
+	}
+
+	i = feof(file);
+	fclose(file);
+	return i;
+}
+
+int main(int argc, char **argv) {
+	pthread_t threads[MAX_THREADS];
+	long threadCount;
+	uint32_t scenario;
+	uint32_t policy;
+	SimResult *result;
+	char cell[32];
+	int i;
+
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s scenario files...\n", argv[0]);
+		return 1;
+	}
+	for(i = 1; i < argc; i++) {
+		if(!loadScenarios(argv[i])) {
+			return 1;
+		}
+	}
+
+	threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+	if(threadCount < 1) {
+		threadCount = 1;
+	}
+	if(threadCount > MAX_THREADS) {
+		threadCount = MAX_THREADS;
+	}
+	for(i = 0; i < threadCount; i++) {
+		pthread_create(&threads[i], NULL, worker, NULL);
+	}
+	for(i = 0; i < threadCount; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	printf("Missed deadlines/brew switches, %u scenarios on %ld threads\n\n", scenarioCount, threadCount);
+	printf("%-56s", "scenario");
+	for(policy = 0; policy < POLICY_COUNT; policy++) {
+		printf("  %8s", POLICY_COLUMNS[policy]);
+	}
+	printf("\n");
+
+	for(scenario = 0; scenario < scenarioCount; scenario++) {
+		printf("%-56s", scenarios[scenario].name);
+		for(policy = 0; policy < POLICY_COUNT; policy++) {
+			result = &results[scenario][policy];
+			if(!(scenarios[scenario].policies & (1 << policy))) {
+				snprintf(cell, sizeof(cell), "-");
+			} else if(!result->ran) {
+				snprintf(cell, sizeof(cell), "idle");
+			} else {
+				snprintf(cell, sizeof(cell), "%u/%u", result->missed, result->switches);
+			}
+			printf("  %8s", cell);
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,406 @@
+/*
+ * Generates Source/cyclictable.c, the schedule CYCLIC_EXECUTIVE dispatches from: which
+ * Coffee brews in each CYCLIC_SLOT of one hyperperiod of the coffee.c catalog, with
+ * every Coffee started at the same time.
+ *
+ * The schedule misses as few deadlines as possible. A set of jobs can all be on time
+ * if and only if EDF meets their deadlines, so a branch and bound search looks for the
+ * largest set EDF can keep on time, and the remaining jobs brew in the time left over,
+ * earliest deadline first. Of the largest sets it keeps the one with the least total
+ * lateness. Every job has to be done by the end of the hyperperiod, so the table can
+ * repeat. On the board a Coffee brews its oldest job first, so the table is checked
+ * once more that way before it is written out.
+ *
+ * It then replays the table on the board's terms, to the ms, with some of every second
+ * going to the scheduler and everything else above the brew worker, and prints the
+ * misses per hyperperiod for both the plain table and dispatchFromTable's way of
+ * finishing jobs that run over their slots first.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/cyclic_table_gen.c Source/coffee.c -o cyclic_table_gen && ./cyclic_table_gen > Source/cyclictable.c
+ *
+ * Rerun it whenever the catalog changes. Until then the board sees that the table no
+ * longer matches the catalog and schedules with the online policy instead.
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+#include "coffee.h"
+#include "cyclictable.h"
+
+// Most jobs in one hyperperiod and most slots in the table
+#define MAX_JOBS 64
+#define MAX_SLOTS 3600
+
+// The board replay: hyperperiods brewed, and the ms of each slot lost to everything above the brew worker
+#define REPLAY_HYPERPERIODS 10
+#define SCHEDULER_DELAY 1000
+static const uint32_t REPLAY_OVERHEADS[] = {0, 1, 5, 20, 50, 100};
+
+typedef struct {
+	Coffee type;
+	uint32_t release;	// slots
+	uint32_t deadline;
+	uint32_t work;
+} TableJob;
+
+static TableJob jobs[MAX_JOBS];
+static uint32_t jobCount;
+static uint32_t slotCount;
+
+static uint64_t bestOnTime;
+static uint32_t bestCount;
+static uint32_t bestLateness;
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+	uint32_t t;
+
+	while(b != 0) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * Brew the jobs over one hyperperiod: the jobs in onTime earliest deadline first, and
+ * the rest earliest deadline first whenever none of those is waiting. Fills in table
+ * if it isn't NULL. Returns how many of the jobs in onTime are late, or jobCount + 1
+ * if anything is left at the end. lateness is the total slots the late jobs are late.
+ */
+static uint32_t brew(uint64_t onTime, uint8_t *table, uint32_t *lateness) {
+	uint32_t remaining[MAX_JOBS];
+	uint32_t late = 0;
+	uint32_t chosen;
+	uint32_t slot;
+	uint32_t i;
+
+	for(i = 0; i < jobCount; i++) {
+		remaining[i] = jobs[i].work;
+	}
+	*lateness = 0;
+
+	for(slot = 0; slot < slotCount; slot++) {
+		chosen = jobCount;
+		for(i = 0; i < jobCount; i++) {
+			if(remaining[i] == 0 || jobs[i].release > slot) {
+				continue;
+			}
+			if(chosen == jobCount || ((onTime >> i) & 1) > ((onTime >> chosen) & 1) ||
+					(((onTime >> i) & 1) == ((onTime >> chosen) & 1) && jobs[i].deadline < jobs[chosen].deadline)) {
+				chosen = i;
+			}
+		}
+		if(table != NULL) {
+			table[slot] = chosen == jobCount ? DEFAULT_COFFEE : jobs[chosen].type;
+		}
+		if(chosen == jobCount) {
+			continue;
+		}
+		remaining[chosen]--;
+		if(remaining[chosen] == 0 && slot + 1 > jobs[chosen].deadline) {
+			*lateness += slot + 1 - jobs[chosen].deadline;
+			if((onTime >> chosen) & 1) {
+				late++;
+			}
+		}
+	}
+
+	for(i = 0; i < jobCount; i++) {
+		if(remaining[i] > 0) {
+			return jobCount + 1;
+		}
+	}
+	return late;
+}
+
+/*
+ * Brew the jobs from table the way the board does, where a Coffee always brews its
+ * oldest job. Returns how many jobs are late, or jobCount + 1 if anything is left at
+ * the end.
+ */
+static uint32_t replay(const uint8_t *table, uint32_t *lateness) {
+	uint32_t remaining[MAX_JOBS];
+	uint32_t late = 0;
+	uint32_t oldest;
+	uint32_t slot;
+	uint32_t i;
+
+	for(i = 0; i < jobCount; i++) {
+		remaining[i] = jobs[i].work;
+	}
+	*lateness = 0;
+
+	for(slot = 0; slot < slotCount; slot++) {
+		oldest = jobCount;
+		for(i = 0; i < jobCount; i++) {
+			if(jobs[i].type == table[slot] && remaining[i] > 0 && jobs[i].release <= slot &&
+					(oldest == jobCount || jobs[i].release < jobs[oldest].release)) {
+				oldest = i;
+			}
+		}
+		if(oldest == jobCount) {
+			continue;
+		}
+		remaining[oldest]--;
+		if(remaining[oldest] == 0 && slot + 1 > jobs[oldest].deadline) {
+			*lateness += slot + 1 - jobs[oldest].deadline;
+			late++;
+		}
+	}
+
+	for(i = 0; i < jobCount; i++) {
+		if(remaining[i] > 0) {
+			return jobCount + 1;
+		}
+	}
+	return late;
+}
+
+typedef enum {
+	DISPATCH_TABLE_ONLY,		// brew what the table says, nothing in an idle slot
+	DISPATCH_FINISH_FIRST		// dispatchFromTable: finish overrunning jobs first, fill idle slots
+} Dispatch;
+
+/*
+ * Whether the table has given a job all the slots its work takes, before slot.
+ */
+static uint32_t hadItsSlots(const uint8_t *table, Coffee type, uint32_t release, uint32_t work, uint32_t slot) {
+	uint32_t given = 0;
+	uint32_t i;
+
+	for(i = release; i < slot; i++) {
+		if(table[i % slotCount] == type) {
+			given++;
+		}
+	}
+	return given * CYCLIC_SLOT >= work;
+}
+
+/*
+ * Brew the table on the board's terms for hyperperiods hyperperiods, to the ms. A pass
+ * comes on every release and otherwise SCHEDULER_DELAY after the last one, and looks
+ * up the nearest slot. overhead ms of every second go to the passes and everything
+ * else above the brew worker, spread evenly. TM_DelayMillis doesn't notice them, so a
+ * job needs a little more than its slots. A worker that finishes its job idles until the next pass. Where
+ * the board falls back to the policy, this uses EDF. Returns how many jobs missed
+ * their deadlines after the first hyperperiod, where the table starts to repeat.
+ */
+static uint32_t replayOnBoard(const uint8_t *table, uint32_t overhead, Dispatch dispatch, uint32_t hyperperiods) {
+	static uint32_t release[MAX_JOBS * REPLAY_HYPERPERIODS];
+	static uint32_t deadline[MAX_JOBS * REPLAY_HYPERPERIODS];
+	static uint32_t remaining[MAX_JOBS * REPLAY_HYPERPERIODS];
+	static Coffee type[MAX_JOBS * REPLAY_HYPERPERIODS];
+	uint32_t oldest[LEDn];
+	uint32_t end = hyperperiods * slotCount * CYCLIC_SLOT;
+	uint32_t count = 0;
+	uint32_t missed = 0;
+	uint32_t chosen = 0;
+	uint32_t nextPass = 0;
+	uint32_t credit = 0;	// the worker's share of the time, in 1/1000 ms
+	uint32_t slot;
+	uint32_t work;
+	uint32_t t;
+	uint32_t i;
+	Coffee c;
+
+	for(i = 0; i < LEDn; i++) {
+		for(t = 0; t < end; t += getCoffeePeriod((Coffee)i)) {
+			type[count] = (Coffee)i;
+			release[count] = t;
+			deadline[count] = t + getCoffeeDeadline((Coffee)i);
+			remaining[count] = getBrewDurations((Coffee)i) + getBrewOverrun((Coffee)i);
+			count++;
+		}
+	}
+
+	for(t = 0; t < end; t++) {
+		for(i = 0; i < count && (release[i] != t || t == 0); i++) {
+		}
+		if(t == nextPass || i < count) {
+			slot = (t + CYCLIC_SLOT / 2) / CYCLIC_SLOT;
+			nextPass = t + SCHEDULER_DELAY;
+			for(c = (Coffee)0; c < LEDn; c++) {
+				oldest[c] = count;
+			}
+			for(i = 0; i < count; i++) {
+				if(remaining[i] > 0 && release[i] <= t && (oldest[type[i]] == count || release[i] < release[oldest[type[i]]])) {
+					oldest[type[i]] = i;
+				}
+			}
+
+			chosen = count;
+			if(dispatch == DISPATCH_FINISH_FIRST) {
+				for(c = (Coffee)0; c < LEDn; c++) {
+					i = oldest[c];
+					work = getBrewDurations(c) + getBrewOverrun(c);
+					if(i < count && remaining[i] < work && hadItsSlots(table, c, release[i] / CYCLIC_SLOT, work, slot) &&
+							(chosen == count || deadline[i] < deadline[chosen])) {
+						chosen = i;
+					}
+				}
+				// and pass again once it should be done
+				if(chosen < count && t + remaining[chosen] + 1 < nextPass) {
+					nextPass = t + remaining[chosen] + 1;
+				}
+			}
+			if(chosen == count && table[slot % slotCount] != DEFAULT_COFFEE) {
+				chosen = oldest[table[slot % slotCount]];
+			}
+			if(chosen == count && (dispatch == DISPATCH_FINISH_FIRST || table[slot % slotCount] != DEFAULT_COFFEE)) {
+				for(c = (Coffee)0; c < LEDn; c++) {
+					if(oldest[c] < count && (chosen == count || deadline[oldest[c]] < deadline[chosen])) {
+						chosen = oldest[c];
+					}
+				}
+			}
+		}
+
+		credit += 1000 - overhead;
+		if(credit < 1000) {
+			continue;
+		}
+		credit -= 1000;
+		if(chosen < count && remaining[chosen] > 0) {
+			remaining[chosen]--;
+			if(remaining[chosen] == 0 && t + 1 > deadline[chosen] && release[chosen] >= slotCount * CYCLIC_SLOT) {
+				missed++;
+			}
+		}
+	}
+
+	for(i = 0; i < count; i++) {
+		if(remaining[i] > 0 && release[i] >= slotCount * CYCLIC_SLOT && deadline[i] <= end) {
+			missed++;
+		}
+	}
+	return missed;
+}
+
+/*
+ * Decide whether job i is on time, given onTime for the jobs before it.
+ */
+static void search(uint32_t i, uint64_t onTime, uint32_t count) {
+	uint32_t lateness;
+	uint64_t with = onTime | ((uint64_t)1 << i);
+
+	if(count + (jobCount - i) < bestCount) {
+		return;
+	}
+	if(i == jobCount) {
+		if(brew(onTime, NULL, &lateness) == 0 && (count > bestCount || lateness < bestLateness)) {
+			bestOnTime = onTime;
+			bestCount = count;
+			bestLateness = lateness;
+		}
+		return;
+	}
+
+	// Jobs that haven't been decided yet brew late for now, so the check only gets
+	// harder as more jobs are added
+	if(brew(with, NULL, &lateness) == 0) {
+		search(i + 1, with, count + 1);
+	}
+	search(i + 1, onTime, count);
+}
+
+int main(void) {
+	static uint8_t table[MAX_SLOTS];
+	uint32_t hyperperiod = 1;
+	uint32_t lateness;
+	uint32_t late;
+	uint32_t release;
+	uint32_t i;
+	TableJob job;
+	uint32_t j;
+
+	for(i = 0; i < LEDn; i++) {
+		if((getBrewDurations((Coffee)i) + getBrewOverrun((Coffee)i)) % CYCLIC_SLOT != 0 ||
+				getCoffeePeriod((Coffee)i) % CYCLIC_SLOT != 0 || getCoffeeDeadline((Coffee)i) % CYCLIC_SLOT != 0) {
+			fprintf(stderr, "%s isn't on the %d ms grid\n", getCoffeeName((Coffee)i), CYCLIC_SLOT);
+			return 1;
+		}
+		hyperperiod = hyperperiod / gcd(hyperperiod, getCoffeePeriod((Coffee)i) / CYCLIC_SLOT) *
+			(getCoffeePeriod((Coffee)i) / CYCLIC_SLOT);
+	}
+	if(hyperperiod > MAX_SLOTS) {
+		fprintf(stderr, "the hyperperiod is longer than %d slots\n", MAX_SLOTS);
+		return 1;
+	}
+	slotCount = hyperperiod;
+
+	jobCount = 0;
+	for(i = 0; i < LEDn; i++) {
+		for(release = 0; release < hyperperiod; release += getCoffeePeriod((Coffee)i) / CYCLIC_SLOT) {
+			if(jobCount == MAX_JOBS) {
+				fprintf(stderr, "more than %d jobs in the hyperperiod\n", MAX_JOBS);
+				return 1;
+			}
+			jobs[jobCount].type = (Coffee)i;
+			jobs[jobCount].release = release;
+			jobs[jobCount].deadline = release + getCoffeeDeadline((Coffee)i) / CYCLIC_SLOT;
+			jobs[jobCount].work = (getBrewDurations((Coffee)i) + getBrewOverrun((Coffee)i)) / CYCLIC_SLOT;
+			jobCount++;
+		}
+	}
+
+	// Search the jobs in deadline order, so the early ones get decided first
+	for(i = 1; i < jobCount; i++) {
+		job = jobs[i];
+		for(j = i; j > 0 && jobs[j - 1].deadline > job.deadline; j--) {
+			jobs[j] = jobs[j - 1];
+		}
+		jobs[j] = job;
+	}
+
+	bestCount = 0;
+	bestLateness = 0xFFFFFFFF;
+	search(0, 0, 0);
+	if(bestLateness == 0xFFFFFFFF) {
+		fprintf(stderr, "no schedule finishes every job within the hyperperiod\n");
+		return 1;
+	}
+
+	brew(bestOnTime, table, &lateness);
+	late = replay(table, &lateness);
+	if(late != jobCount - bestCount) {
+		fprintf(stderr, "%u jobs are late when each Coffee brews its oldest job first, not %u\n", late, jobCount - bestCount);
+		return 1;
+	}
+	fprintf(stderr, "%u s hyperperiod, %u jobs, %u missed, %u s late in total\n",
+		slotCount * CYCLIC_SLOT / 1000, jobCount, jobCount - bestCount, lateness * CYCLIC_SLOT / 1000);
+
+	fprintf(stderr, "\nOn the board, missed per hyperperiod over %d of them\n", REPLAY_HYPERPERIODS - 1);
+	fprintf(stderr, "overhead ms/slot   table only   finish overruns first\n");
+	for(i = 0; i < sizeof(REPLAY_OVERHEADS) / sizeof(REPLAY_OVERHEADS[0]); i++) {
+		fprintf(stderr, "%16u   %10.1f   %21.1f\n", REPLAY_OVERHEADS[i],
+			(double)replayOnBoard(table, REPLAY_OVERHEADS[i], DISPATCH_TABLE_ONLY, REPLAY_HYPERPERIODS) / (REPLAY_HYPERPERIODS - 1),
+			(double)replayOnBoard(table, REPLAY_OVERHEADS[i], DISPATCH_FINISH_FIRST, REPLAY_HYPERPERIODS) / (REPLAY_HYPERPERIODS - 1));
+	}
+
+	printf("// Generated by Tools/cyclic_table_gen.c, rerun it whenever the catalog in coffee.c changes.\n");
+	printf("// %u s hyperperiod, %u jobs, %u missed, %u s late in total.\n",
+		slotCount * CYCLIC_SLOT / 1000, jobCount, jobCount - bestCount, lateness * CYCLIC_SLOT / 1000);
+	printf("#include \"cyclictable.h\"\n\n");
+
+	printf("const CyclicCatalogEntry cyclicCatalog[] = {\n");
+	for(i = 0; i < LEDn; i++) {
+		printf("\t{%u, %u, %u}%s\t// %s\n", getBrewDurations((Coffee)i) + getBrewOverrun((Coffee)i),
+			getCoffeePeriod((Coffee)i), getCoffeeDeadline((Coffee)i), i + 1 < LEDn ? "," : "", getCoffeeName((Coffee)i));
+	}
+	printf("};\n\n");
+	printf("const uint32_t cyclicCatalogSize = %u;\n\n", LEDn);
+
+	printf("// The Coffee to brew in each slot, %u for none\n", DEFAULT_COFFEE);
+	printf("const uint8_t cyclicTable[] = {");
+	for(i = 0; i < slotCount; i++) {
+		printf("%s%u%s", i % 20 == 0 ? "\n\t" : "", table[i], i + 1 < slotCount ? (i % 20 == 19 ? "," : ", ") : "");
+	}
+	printf("\n};\n\n");
+	printf("const uint32_t cyclicTableSize = %u;\n", slotCount);
+	return 0;
+}
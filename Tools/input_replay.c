@@ -0,0 +1,295 @@
+/*
+ * Host side replay of a recorded serial command stream through input.c itself, which
+ * is compiled in here rather than linked so it runs unchanged on the host. The
+ * bytes are fed to USART2_IRQHandler through a stand in for the USART, vSerialCommands
+ * runs in its own thread on stand ins for the FreeRTOS queues, and every InputEvent
+ * it posts is printed against the line that made it. Lines that post nothing were
+ * ignored, the same as on the board.
+ *
+ * -o <n> makes every n-th byte arrive while the interrupt handler is between reading SR
+ * and DR for the byte before it, so the new byte is lost to an overrun. ORE is only
+ * cleared by a DR read after an SR read that saw it, and RXNEIE keeps the interrupt
+ * pending for as long as RXNE or ORE is set, so the replay also checks that the
+ * handler doesn't leave ORE behind and get taken over and over.
+ *
+ * Build and run from the repository root, with the recording on stdin or in a file:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc -I FreeRTOS/include \
+ *     -I FreeRTOS/portable/GCC/ARM_CM4F \
+ *     Tools/input_replay.c Source/coffee.c -pthread -o input_replay
+ *   printf 'start mocha +5\norder 2 latte\nbrew tea\n' | ./input_replay
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+// The port's yield pends PendSV with Cortex-M instructions. Here the interrupt handler
+// just returns, so it is taken out before input.c is pulled in with it
+#undef portYIELD
+#define portYIELD()
+
+#include "input.c"
+
+// Times the interrupt may be taken back to back before it counts as stuck
+#define MAX_REENTRIES 8
+
+#define MAX_QUEUES 4
+#define MAX_LINE 256
+#define MAX_SENT 65536
+
+typedef struct {
+	uint8_t *items;
+	uint32_t itemSize;
+	uint32_t length;
+	uint32_t head;
+	uint32_t count;
+	uint32_t waiting;		// receivers blocked on it
+} HostQueue;
+
+static HostQueue queues[MAX_QUEUES];
+static uint32_t queueCount;
+static pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueChanged = PTHREAD_COND_INITIALIZER;
+
+// The USART's receive side
+static uint16_t dataRegister;
+static uint32_t rxne;
+static uint32_t ore;
+static uint32_t oreRead;		// ORE was set when SR was last read
+static uint32_t arriving;		// a byte is due to arrive just before DR is next read
+static char arrivingByte;
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType) {
+	HostQueue *queue = &queues[queueCount++];
+
+	queue->items = malloc(uxQueueLength * uxItemSize);
+	queue->itemSize = uxItemSize;
+	queue->length = uxQueueLength;
+	return (QueueHandle_t)queue;
+}
+
+static BaseType_t send(QueueHandle_t xQueue, const void *item) {
+	HostQueue *queue = (HostQueue *)xQueue;
+	BaseType_t sent = pdFALSE;
+
+	pthread_mutex_lock(&queueMutex);
+	if(queue->count < queue->length) {
+		memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->itemSize], item, queue->itemSize);
+		queue->count++;
+		sent = pdTRUE;
+		pthread_cond_broadcast(&queueChanged);
+	}
+	pthread_mutex_unlock(&queueMutex);
+	return sent;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition) {
+	return send(xQueue, pvItemToQueue);
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void * const pvItemToQueue, BaseType_t * const pxHigherPriorityTaskWoken, const BaseType_t xCopyPosition) {
+	return send(xQueue, pvItemToQueue);
+}
+
+BaseType_t xQueueGenericReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait, const BaseType_t xJustPeek) {
+	HostQueue *queue = (HostQueue *)xQueue;
+
+	pthread_mutex_lock(&queueMutex);
+	while(queue->count == 0 && xTicksToWait > 0) {
+		queue->waiting++;
+		pthread_cond_broadcast(&queueChanged);
+		pthread_cond_wait(&queueChanged, &queueMutex);
+		queue->waiting--;
+	}
+	if(queue->count == 0) {
+		pthread_mutex_unlock(&queueMutex);
+		return pdFALSE;
+	}
+	memcpy(pvBuffer, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+	queue->head = (queue->head + 1) % queue->length;
+	queue->count--;
+	pthread_cond_broadcast(&queueChanged);
+	pthread_mutex_unlock(&queueMutex);
+	return pdTRUE;
+}
+
+static void receiveByte(char);
+
+static uint32_t readStatus(void) {
+	oreRead = ore;
+	return (rxne ? USART_FLAG_RXNE : 0) | (ore ? USART_FLAG_ORE : 0);
+}
+
+FlagStatus USART_GetFlagStatus(USART_TypeDef* USARTx, uint16_t USART_FLAG) {
+	return (readStatus() & USART_FLAG) ? SET : RESET;
+}
+
+ITStatus USART_GetITStatus(USART_TypeDef* USARTx, uint16_t USART_IT) {
+	return USART_IT == USART_IT_RXNE && (readStatus() & USART_FLAG_RXNE) ? SET : RESET;
+}
+
+/*
+ * Reading DR clears RXNE, and ORE too if the last SR read saw it. A byte due to
+ * arrive comes in first, after SR was read.
+ */
+uint16_t USART_ReceiveData(USART_TypeDef* USARTx) {
+	if(arriving) {
+		arriving = 0;
+		receiveByte(arrivingByte);
+	}
+	rxne = 0;
+	if(oreRead) {
+		ore = 0;
+	}
+	oreRead = 0;
+	return dataRegister;
+}
+
+// Set up calls that have nothing to do on the host
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF) {}
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct) {}
+void RCC_AHB1PeriphClockCmd(uint32_t RCC_AHB1Periph, FunctionalState NewState) {}
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState) {}
+void USART_StructInit(USART_InitTypeDef* USART_InitStruct) {}
+void USART_Init(USART_TypeDef* USARTx, USART_InitTypeDef* USART_InitStruct) {}
+void USART_ITConfig(USART_TypeDef* USARTx, uint16_t USART_IT, FunctionalState NewState) {}
+void USART_Cmd(USART_TypeDef* USARTx, FunctionalState NewState) {}
+void NVIC_Init(NVIC_InitTypeDef* NVIC_InitStruct) {}
+void initializeButton(void) {}
+
+uint32_t waitForButtonPress(ButtonPress *press, TickType_t wait) {
+	*press = SHORT_PRESS;
+	return 0;
+}
+
+/*
+ * A byte coming in off the wire. If the last one hasn't been read yet the new one is
+ * lost and ORE is set.
+ */
+static void receiveByte(char c) {
+	if(rxne) {
+		ore = 1;
+		return;
+	}
+	dataRegister = (uint8_t)c;
+	rxne = 1;
+}
+
+/*
+ * Take the interrupt for as long as RXNEIE keeps it pending. Returns 0 if it never stops.
+ */
+static uint32_t takeInterrupt(void) {
+	uint32_t entries;
+
+	for(entries = 0; (rxne || ore) && entries < MAX_REENTRIES; entries++) {
+		USART2_IRQHandler();
+	}
+	return !rxne && !ore;
+}
+
+/*
+ * Wait until vSerialCommands has taken every character and is blocked waiting for more.
+ */
+static void waitForSerialTask(HostQueue *serialQueue) {
+	pthread_mutex_lock(&queueMutex);
+	while(serialQueue->count > 0 || serialQueue->waiting == 0) {
+		pthread_cond_wait(&queueChanged, &queueMutex);
+	}
+	pthread_mutex_unlock(&queueMutex);
+}
+
+static void *serialTask(void *unused) {
+	vSerialCommands(NULL);
+	return NULL;
+}
+
+static const char *getEventName(InputEventType type) {
+	switch(type) {
+		case INPUT_SINGLE_PRESS:
+			return "single press";
+		case INPUT_DOUBLE_PRESS:
+			return "double press";
+		case INPUT_LONG_PRESS:
+			return "long press";
+		case INPUT_START:
+			return "start";
+		case INPUT_START_ALL:
+			return "start all";
+		default:
+			return "order";
+	}
+}
+
+int main(int argc, char **argv) {
+	static char sent[MAX_SENT];
+	char line[MAX_LINE];
+	uint32_t lineLength = 0;
+	uint32_t lineNumber = 1;
+	uint32_t posted = 0;
+	uint32_t stuck = 0;
+	uint32_t overrunEvery = 0;
+	uint32_t sentCount;
+	InputEvent event;
+	pthread_t thread;
+	FILE *file = stdin;
+	uint32_t j;
+	int i;
+
+	for(i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			overrunEvery = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if((file = fopen(argv[i], "r")) == NULL) {
+			fprintf(stderr, "%s: can't open it\n", argv[i]);
+			return 1;
+		}
+	}
+	sentCount = (uint32_t)fread(sent, 1, sizeof(sent), file);
+
+	initializeInput();
+	pthread_create(&thread, NULL, serialTask, NULL);
+	waitForSerialTask(&queues[1]);
+
+	for(j = 0; j < sentCount; j++) {
+		// A byte that arrived during the interrupt for the one before was still sent
+		if(j == 0 || overrunEvery == 0 || (j + 1) % overrunEvery != 0) {
+			receiveByte(sent[j]);
+			if(overrunEvery > 0 && j + 1 < sentCount && (j + 2) % overrunEvery == 0) {
+				arriving = 1;
+				arrivingByte = sent[j + 1];
+			}
+			if(!takeInterrupt()) {
+				stuck++;
+			}
+		}
+
+		if(sent[j] != '\n') {
+			if(lineLength < MAX_LINE - 1) {
+				line[lineLength++] = sent[j];
+			}
+			continue;
+		}
+
+		waitForSerialTask(&queues[1]);
+		line[lineLength] = '\0';
+		while(receiveInputEvent(&event)) {
+			printf("line %u: %-12s %-10s count %u, +%d s    %s\n", lineNumber, getEventName(event.type),
+				event.coffee == DEFAULT_COFFEE ? "-" : getCoffeeName(event.coffee), event.count, event.at, line);
+			posted++;
+		}
+		if(posted == 0) {
+			printf("line %u: ignored                                      %s\n", lineNumber, line);
+		}
+		posted = 0;
+		lineLength = 0;
+		lineNumber++;
+	}
+
+	printf("%u bytes, %u overruns, interrupt %s\n", sentCount, serialOverruns,
+		stuck == 0 ? "always cleared" : "STUCK, ORE never cleared");
+	return stuck != 0;
+}
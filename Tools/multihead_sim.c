@@ -0,0 +1,223 @@
+/*
+ * Host side simulation of a coffee machine with 1 to MAX_BREW_HEADS brew heads. The
+ * machine brews one copy of the coffee.c catalog per head, with the copies' releases
+ * spread over a period. The periods and deadlines are scaled together until each head
+ * has the load in LOADS, so the load per head stays the same as heads are added.
+ *
+ * Each multiprocessor scheduler is run with an ideal, millisecond granularity
+ * scheduler and checked against the schedulability test in partition.c that goes
+ * with it. Job bookkeeping uses the same job.c as the board.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/multihead_sim.c Source/job.c Source/coffee.c Source/partition.c -o multihead_sim && ./multihead_sim
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+#include "coffee.h"
+#include "job.h"
+#include "partition.h"
+
+// ms simulated for each machine
+#define SIM_TIME 600000
+
+static const double LOADS[] = {0.25, 0.5, 0.75};
+
+typedef enum {
+	GLOBAL_EDF,
+	PARTITIONED_EDF,
+	PARTITIONED_RM,
+	SEMI_PARTITIONED_EDF,
+	SEMI_PARTITIONED_RM
+} Scheduler;
+
+static const char *SCHEDULER_NAMES[] = {"Global EDF", "Partitioned EDF", "Partitioned RM",
+	"Semi-partitioned EDF", "Semi-partitioned RM"};
+
+typedef struct {
+	uint32_t schedulable;	// what the test said
+	uint32_t completed;
+	uint32_t missed;		// finished late, dropped or still waiting past the deadline at the end
+} SimResult;
+
+static BrewLoad loads[MAX_BREW_LOADS];
+static uint32_t phases[MAX_BREW_LOADS];
+static uint32_t loadCount;
+
+/*
+ * One copy of the catalog per head with the periods and deadlines scaled to load each
+ * head by load.
+ */
+static void makeLoads(uint32_t heads, double load) {
+	double u = 0;
+	double shrink;
+	uint32_t copy;
+	uint32_t i;
+
+	for(i = 0; i < LEDn; i++) {
+		u += (double)getBrewDurations((Coffee)i) / getCoffeePeriod((Coffee)i);
+	}
+	shrink = u / load;
+
+	loadCount = 0;
+	for(copy = 0; copy < heads; copy++) {
+		for(i = 0; i < LEDn; i++) {
+			loads[loadCount].work = getBrewDurations((Coffee)i);
+			loads[loadCount].deadline = (uint32_t)(getCoffeeDeadline((Coffee)i) * shrink);
+			loads[loadCount].period = (uint32_t)(getCoffeePeriod((Coffee)i) * shrink);
+			phases[loadCount] = loads[loadCount].period * copy / heads;
+			loadCount++;
+		}
+	}
+}
+
+/*
+ * The head the oldest job of load i brews on at the moment.
+ */
+static uint32_t getHead(const HeadAssignment *assignment, uint32_t i, Job *job) {
+	if(assignment->splitHead != NO_HEAD && loads[i].work - job->remainingWork >= assignment->splitWork) {
+		return assignment->splitHead;
+	}
+	return assignment->head;
+}
+
+/*
+ * Whether a's oldest job goes before b's on one head, or on any head under global EDF.
+ */
+static uint32_t goesFirst(Scheduler scheduler, const HeadAssignment *assignments, JobRing *rings, uint32_t a, uint32_t b) {
+	Job *jobA = peekJob(&rings[a]);
+	Job *jobB = peekJob(&rings[b]);
+	uint32_t firstA;
+	uint32_t firstB;
+
+	if(scheduler != GLOBAL_EDF) {
+		// The first part of a split job goes ahead of everything
+		firstA = assignments[a].splitHead != NO_HEAD && getHead(&assignments[a], a, jobA) == assignments[a].head;
+		firstB = assignments[b].splitHead != NO_HEAD && getHead(&assignments[b], b, jobB) == assignments[b].head;
+		if(firstA != firstB) {
+			return firstA;
+		}
+	}
+	if(scheduler == PARTITIONED_RM || scheduler == SEMI_PARTITIONED_RM) {
+		if(loads[a].period != loads[b].period) {
+			return loads[a].period < loads[b].period;
+		}
+		return a < b;
+	}
+	if(jobA->deadline != jobB->deadline) {
+		return jobA->deadline < jobB->deadline;
+	}
+	return a < b;
+}
+
+static SimResult simulate(uint32_t heads, Scheduler scheduler) {
+	static JobPool pool;
+	static JobRing rings[MAX_BREW_LOADS];
+	HeadAssignment assignments[MAX_BREW_LOADS];
+	uint32_t brewing[MAX_BREW_HEADS];
+	uint32_t chosen;
+	SimResult result = {0};
+	HeadScheduler headScheduler = scheduler == PARTITIONED_RM || scheduler == SEMI_PARTITIONED_RM ?
+		HEAD_RATE_MONOTONIC : HEAD_EARLIEST_DEADLINE_FIRST;
+	Job *job;
+	uint32_t head;
+	int32_t t;
+	uint32_t i;
+
+	if(scheduler == GLOBAL_EDF) {
+		result.schedulable = globalEdfSchedulable(loads, loadCount, heads);
+	} else {
+		result.schedulable = partitionLoads(loads, loadCount, heads, headScheduler,
+			scheduler == SEMI_PARTITIONED_EDF || scheduler == SEMI_PARTITIONED_RM, assignments);
+	}
+
+	initJobPool(&pool);
+	for(i = 0; i < loadCount; i++) {
+		initJobRing(&rings[i], &pool);
+	}
+
+	for(t = 0; t < SIM_TIME; t++) {
+		for(i = 0; i < loadCount; i++) {
+			if(t >= (int32_t)phases[i] && (t - phases[i]) % loads[i].period == 0 &&
+					!pushJob(&rings[i], t, t + loads[i].deadline, loads[i].work)) {
+				result.missed++;
+			}
+		}
+
+		// Pick a job for every head. Under global EDF any job can go on any head,
+		// otherwise each head only looks at the jobs that are on it.
+		chosen = 0;
+		for(head = 0; head < heads; head++) {
+			brewing[head] = MAX_BREW_LOADS;
+			for(i = 0; i < loadCount; i++) {
+				job = peekJob(&rings[i]);
+				if(job == NULL || (chosen & (1u << i)) ||
+						(scheduler != GLOBAL_EDF && getHead(&assignments[i], i, job) != head)) {
+					continue;
+				}
+				if(brewing[head] == MAX_BREW_LOADS || goesFirst(scheduler, assignments, rings, i, brewing[head])) {
+					brewing[head] = i;
+				}
+			}
+			if(brewing[head] != MAX_BREW_LOADS) {
+				chosen |= 1u << brewing[head];
+			}
+		}
+
+		for(head = 0; head < heads; head++) {
+			if(brewing[head] == MAX_BREW_LOADS) {
+				continue;
+			}
+			job = peekJob(&rings[brewing[head]]);
+			job->remainingWork--;
+			if(job->remainingWork <= 0) {
+				if(t + 1 > job->deadline) {
+					result.missed++;
+				}
+				result.completed++;
+				popJob(&rings[brewing[head]]);
+			}
+		}
+	}
+
+	for(i = 0; i < loadCount; i++) {
+		while((job = peekJob(&rings[i])) != NULL) {
+			if(job->deadline < SIM_TIME) {
+				result.missed++;
+			}
+			popJob(&rings[i]);
+		}
+	}
+	return result;
+}
+
+int main(void) {
+	uint32_t load;
+	uint32_t heads;
+	uint32_t scheduler;
+	SimResult result;
+
+	for(load = 0; load < sizeof(LOADS) / sizeof(LOADS[0]); load++) {
+		printf("%.0f%% load per head, %d s: test passed, completed/missed\n", LOADS[load] * 100, SIM_TIME / 1000);
+		printf("heads");
+		for(scheduler = GLOBAL_EDF; scheduler <= SEMI_PARTITIONED_RM; scheduler++) {
+			printf("  %-20s", SCHEDULER_NAMES[scheduler]);
+		}
+		printf("\n");
+
+		for(heads = 1; heads <= MAX_BREW_HEADS; heads++) {
+			makeLoads(heads, LOADS[load]);
+			printf("%5u", heads);
+			for(scheduler = GLOBAL_EDF; scheduler <= SEMI_PARTITIONED_RM; scheduler++) {
+				result = simulate(heads, (Scheduler)scheduler);
+				printf("  %-3s %6u/%-9u", result.schedulable ? "yes" : "no", result.completed, result.missed);
+			}
+			printf("\n");
+		}
+		printf("\n");
+	}
+	return 0;
+}
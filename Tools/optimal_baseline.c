@@ -0,0 +1,722 @@
+/*
+ * Host side baseline for the scheduling policies: the fewest deadlines any schedule
+ * could have missed in a scenario, on the 1 s grid vScheduler makes its decisions on,
+ * next to what fixed priority, EDF and LLF missed. The gap is how far each policy is
+ * from the best that was possible.
+ *
+ * Every job is preemptive and brews on the one brew head. A set of jobs can all be on
+ * time exactly when, for every window from a release to a deadline, the jobs released
+ * and due inside it fit in it. A branch and bound search decides the jobs in deadline
+ * order and finds the largest set that can. It is bounded by the greedy answer and
+ * drops every partial answer that another one dominates. The jobs left out are late
+ * whatever happens, so they can brew at any time. The jobs split into the busy periods
+ * of brewing everything as soon as possible, which don't affect each other, and those
+ * are searched in parallel on every core. The policies brew each coffee's oldest job
+ * first, like the board, which the optimum doesn't have to, so the gap includes what
+ * that costs.
+ *
+ * The scenarios are the investigation.txt ones on the coffee.c catalog, moved onto the
+ * 1 s grid, and random catalogs of 8 drinks with periods that divide 240 s.
+ *
+ * --verify checks the search instead, on VERIFY_CASES small random scenarios. Each one
+ * is also solved by trying every subset of its jobs and brewing the subset EDF, which
+ * is on time whenever any schedule of it is, so it doesn't rely on the window test,
+ * the busy periods or the pruning. It prints any case where the two disagree.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -pthread -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/optimal_baseline.c Source/coffee.c -o optimal_baseline && ./optimal_baseline
+ *   ./optimal_baseline --verify
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "coffee.h"
+
+#define MAX_DRINKS 8
+#define MAX_JOBS 256
+#define MAX_SCENARIOS 64
+#define MAX_PARTS (MAX_SCENARIOS * MAX_JOBS / 4)
+
+// Random catalogs for each load
+#define RANDOM_CATALOGS 16
+#define RANDOM_HORIZON 240
+
+static const double RANDOM_LOADS[] = {0.7, 0.9, 1.1};
+static const uint32_t RANDOM_PERIODS[] = {10, 12, 15, 16, 20, 24, 30, 40, 48, 60, 80, 120, 240};
+
+// Small scenarios for --verify, few enough jobs to try every subset of them
+#define VERIFY_CASES 300
+#define VERIFY_DRINKS 3
+#define VERIFY_HORIZON 12
+#define VERIFY_MAX_JOBS 16
+
+typedef enum {
+	FIXED_PRIORITY,
+	EARLIEST_DEADLINE_FIRST,
+	LEAST_LAXITY_FIRST,
+	POLICY_COUNT
+} Policy;
+
+/*
+ * One drink of a scenario. All times are in seconds.
+ */
+typedef struct {
+	uint32_t work;
+	uint32_t period;
+	uint32_t deadline;
+	int32_t start;			// -1 if it is never started
+	uint32_t priority;		// for fixed priority, higher goes first
+} Drink;
+
+typedef struct {
+	char name[64];
+	uint32_t drinkCount;
+	Drink drinks[MAX_DRINKS];
+	uint32_t horizon;		// jobs are released up to here
+	double load;
+	uint32_t jobCount;
+	uint32_t optimal;		// fewest jobs that can be late
+	uint32_t missed[POLICY_COUNT];
+} Scenario;
+
+typedef struct {
+	uint32_t drink;
+	uint32_t release;
+	uint32_t deadline;
+	uint32_t work;
+} GridJob;
+
+/*
+ * A busy period of one scenario, searched on its own.
+ */
+typedef struct {
+	Scenario *scenario;
+	GridJob jobs[MAX_JOBS];
+	uint32_t count;
+	uint32_t onTime;		// the most jobs that can be on time
+} Part;
+
+static Scenario scenarios[MAX_SCENARIOS];
+static uint32_t scenarioCount;
+static Part parts[MAX_PARTS];
+static uint32_t partCount;
+static uint32_t nextPart;
+static pthread_mutex_t partLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t seed = 1;
+
+/*
+ * Numerical Recipes' linear congruential generator, so every run makes the same catalogs.
+ */
+static uint32_t nextRandom(void) {
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+/*
+ * Every job a scenario releases, in deadline order.
+ */
+static uint32_t makeJobs(const Scenario *scenario, GridJob *jobs) {
+	uint32_t count = 0;
+	uint32_t release;
+	GridJob job;
+	uint32_t i;
+	uint32_t j;
+
+	for(i = 0; i < scenario->drinkCount; i++) {
+		if(scenario->drinks[i].start < 0) {
+			continue;
+		}
+		for(release = scenario->drinks[i].start; release < scenario->horizon && count < MAX_JOBS;
+				release += scenario->drinks[i].period) {
+			jobs[count].drink = i;
+			jobs[count].release = release;
+			jobs[count].deadline = release + scenario->drinks[i].deadline;
+			jobs[count].work = scenario->drinks[i].work;
+			count++;
+		}
+	}
+
+	for(i = 1; i < count; i++) {
+		job = jobs[i];
+		for(j = i; j > 0 && (jobs[j - 1].deadline > job.deadline ||
+				(jobs[j - 1].deadline == job.deadline && jobs[j - 1].release > job.release)); j--) {
+			jobs[j] = jobs[j - 1];
+		}
+		jobs[j] = job;
+	}
+	return count;
+}
+
+/*
+ * A partial answer: how many of the jobs decided so far are on time, and for each
+ * release time in the busy period, how much on time work is released then or later.
+ */
+typedef struct {
+	uint32_t count;
+	uint32_t demand[MAX_JOBS];
+} Choice;
+
+/*
+ * Whether job i can be on time along with the jobs choice already has, none of which
+ * is due after it. Only the windows that end at job i's deadline can have become too
+ * full.
+ */
+static uint32_t fits(const Part *part, const uint32_t *releases, uint32_t releaseCount, const Choice *choice, uint32_t i) {
+	uint32_t a;
+
+	for(a = 0; a < releaseCount && releases[a] < part->jobs[i].deadline; a++) {
+		if(choice->demand[a] + (part->jobs[i].release >= releases[a] ? part->jobs[i].work : 0) >
+				part->jobs[i].deadline - releases[a]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Whether a is at least as good a start for the jobs still to decide as b: as many
+ * on time, and no more work left to fit in any window.
+ */
+static uint32_t dominates(const Choice *a, const Choice *b, uint32_t releaseCount) {
+	uint32_t r;
+
+	if(a->count < b->count) {
+		return 0;
+	}
+	for(r = 0; r < releaseCount; r++) {
+		if(a->demand[r] > b->demand[r]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Decide the jobs one at a time in deadline order, keeping every partial answer that
+ * no other one dominates and that could still beat the greedy answer.
+ */
+static void solvePart(Part *part) {
+	uint32_t releases[MAX_JOBS];
+	uint32_t releaseCount = 0;
+	Choice *choices;
+	Choice *next;
+	uint32_t choiceCount = 1;
+	uint32_t nextCount;
+	uint32_t capacity = 1024;
+	uint32_t greedy = 0;
+	Choice choice = {0};
+	uint32_t kept;
+	uint32_t r;
+	uint32_t c;
+	uint32_t i;
+	uint32_t j;
+
+	for(i = 0; i < part->count; i++) {
+		for(r = 0; r < releaseCount && releases[r] != part->jobs[i].release; r++) {
+		}
+		if(r == releaseCount) {
+			for(r = releaseCount++; r > 0 && releases[r - 1] > part->jobs[i].release; r--) {
+				releases[r] = releases[r - 1];
+			}
+			releases[r] = part->jobs[i].release;
+		}
+	}
+
+	// The greedy answer, taking every job that still fits, is the one to beat
+	for(i = 0; i < part->count; i++) {
+		if(fits(part, releases, releaseCount, &choice, i)) {
+			choice.count++;
+			for(r = 0; r < releaseCount && releases[r] <= part->jobs[i].release; r++) {
+				choice.demand[r] += part->jobs[i].work;
+			}
+		}
+	}
+	greedy = choice.count;
+
+	choices = malloc(capacity * sizeof(Choice));
+	next = malloc(capacity * sizeof(Choice));
+	choices[0].count = 0;
+	for(r = 0; r < releaseCount; r++) {
+		choices[0].demand[r] = 0;
+	}
+
+	for(i = 0; i < part->count; i++) {
+		nextCount = 0;
+		for(c = 0; c < choiceCount; c++) {
+			if(nextCount + 2 > capacity) {
+				capacity *= 2;
+				choices = realloc(choices, capacity * sizeof(Choice));
+				next = realloc(next, capacity * sizeof(Choice));
+			}
+			if(fits(part, releases, releaseCount, &choices[c], i)) {
+				next[nextCount] = choices[c];
+				next[nextCount].count++;
+				for(r = 0; r < releaseCount && releases[r] <= part->jobs[i].release; r++) {
+					next[nextCount].demand[r] += part->jobs[i].work;
+				}
+				nextCount++;
+			}
+			if(choices[c].count + part->count - i - 1 >= greedy) {
+				next[nextCount++] = choices[c];
+			}
+		}
+
+		// Keep only the ones nothing else dominates
+		kept = 0;
+		for(c = 0; c < nextCount; c++) {
+			for(j = 0; j < kept && !dominates(&choices[j], &next[c], releaseCount); j++) {
+			}
+			if(j < kept) {
+				continue;
+			}
+			for(j = 0; j < kept; ) {
+				if(dominates(&next[c], &choices[j], releaseCount)) {
+					choices[j] = choices[--kept];
+				} else {
+					j++;
+				}
+			}
+			choices[kept++] = next[c];
+		}
+		choiceCount = kept;
+	}
+
+	part->onTime = greedy;
+	for(c = 0; c < choiceCount; c++) {
+		if(choices[c].count > part->onTime) {
+			part->onTime = choices[c].count;
+		}
+	}
+	free(choices);
+	free(next);
+}
+
+static void *solveParts(void *unused) {
+	uint32_t i;
+
+	for(;;) {
+		pthread_mutex_lock(&partLock);
+		i = nextPart++;
+		pthread_mutex_unlock(&partLock);
+		if(i >= partCount) {
+			return NULL;
+		}
+		solvePart(&parts[i]);
+	}
+}
+
+/*
+ * Split a scenario's jobs into the busy periods of brewing everything as soon as
+ * possible. A job released after the brew head has caught up can't be held up by
+ * anything before it.
+ */
+static void splitScenario(Scenario *scenario) {
+	GridJob jobs[MAX_JOBS];
+	uint32_t order[MAX_JOBS];
+	uint32_t busyUntil = 0;
+	Part *part = NULL;
+	uint32_t i;
+	uint32_t j;
+
+	scenario->jobCount = makeJobs(scenario, jobs);
+
+	// Go through them in release order
+	for(i = 0; i < scenario->jobCount; i++) {
+		for(j = i; j > 0 && jobs[order[j - 1]].release > jobs[i].release; j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+	}
+
+	for(i = 0; i < scenario->jobCount; i++) {
+		if(part == NULL || jobs[order[i]].release >= busyUntil) {
+			part = &parts[partCount++];
+			part->scenario = scenario;
+			part->count = 0;
+			busyUntil = jobs[order[i]].release;
+		}
+		busyUntil += jobs[order[i]].work;
+		part->jobs[part->count++] = jobs[order[i]];
+	}
+
+	// and each busy period in deadline order again
+	for(i = partCount; i > 0 && parts[i - 1].scenario == scenario; i--) {
+		part = &parts[i - 1];
+		for(j = 1; j < part->count; j++) {
+			GridJob job = part->jobs[j];
+			uint32_t k;
+
+			for(k = j; k > 0 && (part->jobs[k - 1].deadline > job.deadline ||
+					(part->jobs[k - 1].deadline == job.deadline && part->jobs[k - 1].release > job.release)); k--) {
+				part->jobs[k] = part->jobs[k - 1];
+			}
+			part->jobs[k] = job;
+		}
+	}
+}
+
+/*
+ * Brew a scenario one second at a time under policy, each drink's oldest job first,
+ * until every job is done. Returns how many were late.
+ */
+static uint32_t simulate(const Scenario *scenario, Policy policy) {
+	GridJob jobs[MAX_JOBS];
+	uint32_t remaining[MAX_JOBS];
+	uint32_t count = makeJobs(scenario, jobs);
+	uint32_t done = 0;
+	uint32_t missed = 0;
+	uint32_t oldest[MAX_DRINKS];
+	uint32_t chosen;
+	int32_t key;
+	int32_t bestKey = 0;
+	uint32_t t;
+	uint32_t i;
+	uint32_t d;
+
+	for(i = 0; i < count; i++) {
+		remaining[i] = jobs[i].work;
+	}
+
+	for(t = 0; done < count; t++) {
+		for(d = 0; d < scenario->drinkCount; d++) {
+			oldest[d] = count;
+		}
+		for(i = 0; i < count; i++) {
+			d = jobs[i].drink;
+			if(remaining[i] > 0 && jobs[i].release <= t && (oldest[d] == count || jobs[i].release < jobs[oldest[d]].release)) {
+				oldest[d] = i;
+			}
+		}
+
+		chosen = count;
+		for(d = 0; d < scenario->drinkCount; d++) {
+			i = oldest[d];
+			if(i == count) {
+				continue;
+			}
+			switch(policy) {
+				case FIXED_PRIORITY:
+					key = -(int32_t)scenario->drinks[d].priority;
+					break;
+				case EARLIEST_DEADLINE_FIRST:
+					key = (int32_t)jobs[i].deadline;
+					break;
+				default:
+					key = (int32_t)jobs[i].deadline - (int32_t)t - (int32_t)remaining[i];
+					break;
+			}
+			if(chosen == count || key < bestKey || (key == bestKey &&
+					scenario->drinks[d].priority > scenario->drinks[jobs[chosen].drink].priority)) {
+				chosen = i;
+				bestKey = key;
+			}
+		}
+		if(chosen == count) {
+			continue;
+		}
+
+		remaining[chosen]--;
+		if(remaining[chosen] == 0) {
+			done++;
+			if(t + 1 > jobs[chosen].deadline) {
+				missed++;
+			}
+		}
+	}
+	return missed;
+}
+
+/*
+ * A scenario on the coffee.c catalog, with start times in seconds.
+ */
+static void addCatalogScenario(const char *name, int32_t latte, int32_t espresso, int32_t mocha, int32_t cappuccino,
+		uint32_t horizon) {
+	Scenario *scenario = &scenarios[scenarioCount++];
+	int32_t starts[LEDn] = {latte, espresso, mocha, cappuccino};
+	uint32_t i;
+
+	snprintf(scenario->name, sizeof(scenario->name), "%s", name);
+	scenario->drinkCount = LEDn;
+	scenario->horizon = horizon;
+	scenario->load = 0;
+	for(i = 0; i < LEDn; i++) {
+		scenario->drinks[i].work = getBrewDurations((Coffee)i) / 1000;
+		scenario->drinks[i].period = getCoffeePeriod((Coffee)i) / 1000;
+		scenario->drinks[i].deadline = getCoffeeDeadline((Coffee)i) / 1000;
+		scenario->drinks[i].start = starts[i];
+		scenario->drinks[i].priority = getCoffeePriority((Coffee)i);
+	}
+}
+
+/*
+ * 8 drinks started together with utilisations that add up to load, split UUniFast
+ * style, and deadlines somewhere between their brew times and periods. Fixed priority
+ * goes by deadline monotonic.
+ */
+static void addRandomScenario(double load, uint32_t number) {
+	Scenario *scenario = &scenarios[scenarioCount++];
+	double left = load;
+	double next;
+	double u;
+	uint32_t rank;
+	uint32_t i;
+	uint32_t j;
+
+	snprintf(scenario->name, sizeof(scenario->name), "random %.0f%% #%u", load * 100, number);
+	scenario->drinkCount = MAX_DRINKS;
+	scenario->horizon = RANDOM_HORIZON;
+	scenario->load = load;
+	for(i = 0; i < MAX_DRINKS; i++) {
+		if(i + 1 < MAX_DRINKS) {
+			next = left;
+			for(j = i + 1; j < MAX_DRINKS; j++) {
+				next *= (double)(nextRandom() % 1000 + 1) / 1001;
+			}
+			u = left - next;
+			left = next;
+		} else {
+			u = left;
+		}
+		scenario->drinks[i].period = RANDOM_PERIODS[nextRandom() % (sizeof(RANDOM_PERIODS) / sizeof(RANDOM_PERIODS[0]))];
+		scenario->drinks[i].work = (uint32_t)(u * scenario->drinks[i].period + 0.5);
+		if(scenario->drinks[i].work == 0) {
+			scenario->drinks[i].work = 1;
+		}
+		if(scenario->drinks[i].work > scenario->drinks[i].period) {
+			scenario->drinks[i].work = scenario->drinks[i].period;
+		}
+		scenario->drinks[i].deadline = scenario->drinks[i].work +
+			nextRandom() % (scenario->drinks[i].period - scenario->drinks[i].work + 1);
+		scenario->drinks[i].start = 0;
+	}
+	for(i = 0; i < MAX_DRINKS; i++) {
+		rank = 0;
+		for(j = 0; j < MAX_DRINKS; j++) {
+			if(scenario->drinks[j].deadline > scenario->drinks[i].deadline ||
+					(scenario->drinks[j].deadline == scenario->drinks[i].deadline && j > i)) {
+				rank++;
+			}
+		}
+		scenario->drinks[i].priority = rank;
+	}
+}
+
+/*
+ * A scenario small enough for verify: VERIFY_DRINKS drinks with short periods and
+ * random start times, and at most VERIFY_MAX_JOBS jobs.
+ */
+static void makeSmallScenario(Scenario *scenario, uint32_t number) {
+	GridJob jobs[MAX_JOBS];
+	uint32_t i;
+
+	do {
+		snprintf(scenario->name, sizeof(scenario->name), "small #%u", number);
+		scenario->drinkCount = VERIFY_DRINKS;
+		scenario->horizon = VERIFY_HORIZON;
+		scenario->load = 0;
+		scenario->optimal = 0;
+		for(i = 0; i < VERIFY_DRINKS; i++) {
+			scenario->drinks[i].period = 2 + nextRandom() % 5;
+			scenario->drinks[i].work = 1 + nextRandom() % scenario->drinks[i].period;
+			scenario->drinks[i].deadline = scenario->drinks[i].work +
+				nextRandom() % (scenario->drinks[i].period - scenario->drinks[i].work + 1);
+			scenario->drinks[i].start = nextRandom() % scenario->drinks[i].period;
+			scenario->drinks[i].priority = i;
+		}
+	} while(makeJobs(scenario, jobs) > VERIFY_MAX_JOBS);
+}
+
+/*
+ * Whether the jobs in subset can all be on time: brew them EDF one second at a time.
+ */
+static uint32_t subsetOnTime(const GridJob *jobs, uint32_t count, uint32_t subset) {
+	uint32_t remaining[VERIFY_MAX_JOBS];
+	uint32_t left = 0;
+	uint32_t chosen;
+	uint32_t t;
+	uint32_t i;
+
+	for(i = 0; i < count; i++) {
+		remaining[i] = (subset >> i) & 1 ? jobs[i].work : 0;
+		left += remaining[i];
+	}
+	for(t = 0; left > 0; t++) {
+		chosen = count;
+		for(i = 0; i < count; i++) {
+			if(remaining[i] > 0 && jobs[i].release <= t && (chosen == count || jobs[i].deadline < jobs[chosen].deadline)) {
+				chosen = i;
+			}
+		}
+		if(chosen == count) {
+			continue;
+		}
+		remaining[chosen]--;
+		left--;
+		if(remaining[chosen] == 0 && t + 1 > jobs[chosen].deadline) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * The fewest jobs of a scenario that can be late, by trying every subset of them.
+ */
+static uint32_t bruteForceOptimal(const Scenario *scenario) {
+	GridJob jobs[MAX_JOBS];
+	uint32_t count = makeJobs(scenario, jobs);
+	uint32_t most = 0;
+	uint32_t subset;
+
+	for(subset = 0; subset < 1u << count; subset++) {
+		if((uint32_t)__builtin_popcount(subset) > most && subsetOnTime(jobs, count, subset)) {
+			most = __builtin_popcount(subset);
+		}
+	}
+	return count - most;
+}
+
+/*
+ * Check the search against trying every subset on VERIFY_CASES small scenarios.
+ */
+static int verify(void) {
+	Scenario *scenario = &scenarios[0];
+	uint32_t disagreements = 0;
+	uint32_t jobs = 0;
+	uint32_t late = 0;
+	uint32_t expected;
+	uint32_t part;
+	uint32_t i;
+
+	for(i = 0; i < VERIFY_CASES; i++) {
+		makeSmallScenario(scenario, i + 1);
+		partCount = 0;
+		splitScenario(scenario);
+		for(part = 0; part < partCount; part++) {
+			solvePart(&parts[part]);
+			scenario->optimal += parts[part].count - parts[part].onTime;
+		}
+
+		expected = bruteForceOptimal(scenario);
+		jobs += scenario->jobCount;
+		late += expected;
+		if(scenario->optimal != expected) {
+			printf("%s: search %u late, every subset %u late\n", scenario->name, scenario->optimal, expected);
+			disagreements++;
+		}
+	}
+
+	printf("%d small scenarios, %u jobs, %u late at best: %s\n", VERIFY_CASES, jobs, late,
+		disagreements == 0 ? "the search agrees with trying every subset" : "the search DISAGREES");
+	return disagreements != 0;
+}
+
+int main(int argc, char **argv) {
+	pthread_t threads[64];
+	long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+	struct timespec started;
+	struct timespec finished;
+	uint32_t gap[POLICY_COUNT];
+	uint32_t maxGap[POLICY_COUNT];
+	uint32_t optimal;
+	uint32_t jobs;
+	uint32_t policy;
+	uint32_t load;
+	uint32_t i;
+
+	if(argc > 1 && strcmp(argv[1], "--verify") == 0) {
+		return verify();
+	}
+
+	addCatalogScenario("all four at 0 s, 120 s", 0, 0, 0, 0, 120);
+	addCatalogScenario("all four at 0 s, 240 s", 0, 0, 0, 0, 240);
+	addCatalogScenario("espresso, latte, mocha 1 s apart, 240 s", 1, 0, 2, -1, 240);
+	addCatalogScenario("all four 1 s apart, 240 s", 0, 1, 2, 3, 240);
+	for(load = 0; load < sizeof(RANDOM_LOADS) / sizeof(RANDOM_LOADS[0]); load++) {
+		for(i = 0; i < RANDOM_CATALOGS; i++) {
+			addRandomScenario(RANDOM_LOADS[load], i + 1);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	for(i = 0; i < scenarioCount; i++) {
+		splitScenario(&scenarios[i]);
+		for(policy = 0; policy < POLICY_COUNT; policy++) {
+			scenarios[i].missed[policy] = simulate(&scenarios[i], (Policy)policy);
+		}
+	}
+
+	if(threadCount < 1) {
+		threadCount = 1;
+	}
+	if(threadCount > 64) {
+		threadCount = 64;
+	}
+	for(i = 0; i < threadCount; i++) {
+		pthread_create(&threads[i], NULL, solveParts, NULL);
+	}
+	for(i = 0; i < threadCount; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	for(i = 0; i < partCount; i++) {
+		parts[i].scenario->optimal += parts[i].count - parts[i].onTime;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &finished);
+
+	printf("%u scenarios, %u busy periods searched on %ld threads in %.2f s\n\n", scenarioCount, partCount, threadCount,
+		(finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9);
+
+	printf("Missed deadlines (gap to optimal)\n");
+	printf("scenario                                   jobs  optimal  Fixed Priority       EDF       LLF\n");
+	for(i = 0; i < scenarioCount; i++) {
+		if(scenarios[i].load != 0) {
+			continue;
+		}
+		printf("%-41s  %4u  %7u", scenarios[i].name, scenarios[i].jobCount, scenarios[i].optimal);
+		for(policy = 0; policy < POLICY_COUNT; policy++) {
+			printf("  %*u (+%u)", policy == 0 ? 9 : 4, scenarios[i].missed[policy],
+				scenarios[i].missed[policy] - scenarios[i].optimal);
+		}
+		printf("\n");
+	}
+
+	printf("\n%d random catalogs of %d drinks per load, %d s, total missed (total gap, largest gap)\n",
+		RANDOM_CATALOGS, MAX_DRINKS, RANDOM_HORIZON);
+	printf("load   jobs  optimal  Fixed Priority        EDF               LLF\n");
+	for(load = 0; load < sizeof(RANDOM_LOADS) / sizeof(RANDOM_LOADS[0]); load++) {
+		jobs = 0;
+		optimal = 0;
+		for(policy = 0; policy < POLICY_COUNT; policy++) {
+			gap[policy] = 0;
+			maxGap[policy] = 0;
+		}
+		for(i = 0; i < scenarioCount; i++) {
+			if(scenarios[i].load != RANDOM_LOADS[load]) {
+				continue;
+			}
+			jobs += scenarios[i].jobCount;
+			optimal += scenarios[i].optimal;
+			for(policy = 0; policy < POLICY_COUNT; policy++) {
+				gap[policy] += scenarios[i].missed[policy] - scenarios[i].optimal;
+				if(scenarios[i].missed[policy] - scenarios[i].optimal > maxGap[policy]) {
+					maxGap[policy] = scenarios[i].missed[policy] - scenarios[i].optimal;
+				}
+			}
+		}
+		printf("%3.0f%%  %5u  %7u", RANDOM_LOADS[load] * 100, jobs, optimal);
+		for(policy = 0; policy < POLICY_COUNT; policy++) {
+			printf("  %4u (+%u, +%u)%*s", optimal + gap[policy], gap[policy], maxGap[policy], policy == 0 ? 3 : 2, "");
+		}
+		printf("\n");
+	}
+	return 0;
+}
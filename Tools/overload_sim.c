@@ -0,0 +1,155 @@
+/*
+ * Host side simulation of the coffee task set under overload. The periods from
+ * coffee.c are shortened until the total utilisation reaches each load in LOADS,
+ * then every OverloadPolicy is run against it under EDF and fixed priority with an
+ * ideal, millisecond granularity scheduler. Job bookkeeping uses the same job.c as
+ * the board.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/overload_sim.c Source/job.c Source/coffee.c -o overload_sim && ./overload_sim
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+#include "coffee.h"
+#include "job.h"
+
+// Ten hyperperiods of the unscaled catalog (lcm of 20, 30 and 40 s), in ms
+#define SIM_TIME 1200000
+
+static const double LOADS[] = {1.1, 1.2, 1.3, 1.4, 1.5};
+static const char *POLICY_NAMES[] = {"run late", "abort", "skip", "degrade"};
+
+typedef enum {
+	SIM_EDF,
+	SIM_FIXED_PRIORITY
+} SimScheduler;
+
+typedef struct {
+	uint32_t released;
+	uint32_t onTime;
+	uint32_t missed;	// finished late, aborted, dropped or still waiting past the deadline at the end
+	uint32_t skipped;
+	uint32_t degraded;
+} SimResult;
+
+static double catalogUtilisation() {
+	double u = 0;
+	uint32_t i;
+
+	for(i = 0; i < LEDn; i++) {
+		u += (double)getBrewDurations((Coffee)i) / getCoffeePeriod((Coffee)i);
+	}
+	return u;
+}
+
+/*
+ * The type whose oldest job should brew now, or DEFAULT_COFFEE if nothing is waiting.
+ */
+static Coffee selectCoffee(JobRing *rings, SimScheduler scheduler) {
+	Coffee selected = DEFAULT_COFFEE;
+	int32_t best = 0;
+	int32_t key;
+	uint32_t i;
+
+	for(i = 0; i < LEDn; i++) {
+		if(rings[i].count == 0) {
+			continue;
+		}
+		key = scheduler == SIM_EDF ? -peekJob(&rings[i])->deadline : (int32_t)getCoffeePriority((Coffee)i);
+		if(selected == DEFAULT_COFFEE || key > best ||
+				(key == best && getCoffeePriority((Coffee)i) > getCoffeePriority(selected))) {
+			selected = (Coffee)i;
+			best = key;
+		}
+	}
+	return selected;
+}
+
+static SimResult simulate(double load, OverloadPolicy policy, SimScheduler scheduler) {
+	JobPool pool;
+	JobRing rings[LEDn];
+	int32_t period[LEDn];
+	double shrink = catalogUtilisation() / load;
+	SimResult result = {0};
+	Coffee brewing;
+	Job *job;
+	int32_t t;
+	uint32_t i;
+
+	initJobPool(&pool);
+	for(i = 0; i < LEDn; i++) {
+		initJobRing(&rings[i], &pool);
+		period[i] = (int32_t)(getCoffeePeriod((Coffee)i) * shrink);
+	}
+
+	for(t = 0; t < SIM_TIME; t++) {
+		for(i = 0; i < LEDn; i++) {
+			if(t % period[i] == 0) {
+				result.released++;
+				if(policy == OVERLOAD_SKIP && rings[i].count > 0) {
+					result.skipped++;
+				} else if(!pushJob(&rings[i], t, t + getCoffeeDeadline((Coffee)i), getBrewDurations((Coffee)i))) {
+					result.missed++;
+				}
+			}
+
+			if(policy == OVERLOAD_ABORT) {
+				result.missed += abortLateJobs(&rings[i], t);
+			} else if(policy == OVERLOAD_DEGRADE) {
+				result.degraded += degradeLateJob(&rings[i], t, 
+					getBrewDurations((Coffee)i) - getDegradedBrewDuration((Coffee)i));
+			}
+		}
+
+		brewing = selectCoffee(rings, scheduler);
+		if(brewing == DEFAULT_COFFEE) {
+			continue;
+		}
+
+		job = peekJob(&rings[brewing]);
+		job->remainingWork--;
+		if(job->remainingWork <= 0) {
+			if(t + 1 > job->deadline) {
+				result.missed++;
+			} else {
+				result.onTime++;
+			}
+			popJob(&rings[brewing]);
+		}
+	}
+
+	for(i = 0; i < LEDn; i++) {
+		while((job = peekJob(&rings[i])) != NULL) {
+			if(job->deadline < SIM_TIME) {
+				result.missed++;
+			}
+			popJob(&rings[i]);
+		}
+	}
+	return result;
+}
+
+int main(void) {
+	SimScheduler scheduler;
+	SimResult result;
+	uint32_t load;
+	uint32_t policy;
+
+	for(scheduler = SIM_EDF; scheduler <= SIM_FIXED_PRIORITY; scheduler++) {
+		printf("%s, %d s\n", scheduler == SIM_EDF ? "Earliest Deadline First" : "Fixed Priority", SIM_TIME / 1000);
+		printf("load  policy    released  on time  missed  skipped  degraded\n");
+		for(load = 0; load < sizeof(LOADS) / sizeof(LOADS[0]); load++) {
+			for(policy = OVERLOAD_RUN_LATE; policy <= OVERLOAD_DEGRADE; policy++) {
+				result = simulate(LOADS[load], (OverloadPolicy)policy, scheduler);
+				printf("%3.0f%%  %-8s  %8u  %7u  %6u  %7u  %8u\n", LOADS[load] * 100, POLICY_NAMES[policy],
+					result.released, result.onTime, result.missed, result.skipped, result.degraded);
+			}
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Host side check of the timer driven releases: each started coffee's auto-reload
+ * software timer, run until every coffee has been released RELEASES times. It checks
+ * that every release comes once, and measures how late vReleaseTimerCallback runs
+ * after the release time it stamps (maxReleaseJitter on the board).
+ *
+ * The timers follow FreeRTOS V9's timers.c: a reset command starts the period from
+ * the time carried in the command, and an auto-reload timer is put back a period
+ * after the time it was due rather than after the time it was handled, so lateness
+ * never builds up. The timer daemon runs at configTIMER_TASK_PRIORITY, so on a tick a
+ * timer is due it waits for the tick interrupt, the sound service mixing a chime and
+ * the scheduler pass. These are modelled with the costs below, which are estimates,
+ * the pass cost being swept. None of them are measured; DISPATCH_TIMING in main.c
+ * keeps the longest pass on the board in maxPassCycles to compare the sweep with. Each release wakes the scheduler for a pass, and it
+ * also passes SCHEDULER_DELAY after the last one. A chime is mixed for 500 ms from
+ * the end of each coffee's brew. Everything else on the board runs below the daemon.
+ *
+ * The coffees are started together by a serial command, part way through a tick.
+ * startCoffeeType reads the tick count for startTime and then, after releasing the
+ * first job, resets the timer. With xTimerReset the reset reads the tick count again,
+ * so if a tick comes in between, every later release of that coffee is a tick late.
+ * Resetting the timer from startTime, as startCoffeeType does now, doesn't have that.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/release_sim.c Source/coffee.c -o release_sim && ./release_sim
+ */
+#include <stdio.h>
+
+#include "coffee.h"
+
+// The same value as main.c
+#define SCHEDULER_DELAY 1000
+
+// Releases of each coffee checked in every run
+#define RELEASES 10000
+
+// Estimated costs, us
+#define TICK_COST 5				// the tick interrupt, which also unblocks the daemon
+#define CALLBACK_COST 15		// the daemon handling one expired timer
+#define START_COST 60			// startCoffeeType from reading startTime to resetting the timer
+#define MIX_COST 80				// mixing one DMA half of four voices
+#define MIX_PERIOD 5333			// one DMA half, 256 frames at 48 kHz
+#define CHIME_TIME 500000
+
+// Scheduler pass costs tried, us
+static const int64_t PASS_COSTS[] = {100, 300, 600, 900, 1500};
+
+// Where in the tick the serial command starting the coffees is handled, us
+#define START_OFFSETS 20
+
+typedef enum {
+	RESET_FROM_TICK_COUNT,		// xTimerReset
+	RESET_FROM_START_TIME		// xTimerGenericCommand with startTime, as startCoffeeType does
+} ResetMode;
+
+typedef struct {
+	uint32_t releases;
+	uint32_t maxJitter;			// ticks
+	uint32_t lateStarts;		// coffees whose timer started a tick after startTime
+	uint32_t wrongCount;		// coffees released more or less often than they should be
+} SimResult;
+
+static SimResult simulate(int64_t passCost, int64_t startOffset, ResetMode mode) {
+	int64_t startTime[LEDn];
+	int64_t expiry[LEDn];		// ticks, the timer list
+	uint32_t releases[LEDn] = {0};
+	int64_t chimeFrom[LEDn];	// us
+	int64_t chimeUntil[LEDn];
+	int64_t soundBacklog = 0;	// us of work ready at each priority
+	int64_t schedulerBacklog = 0;
+	int64_t nextMix = 0;
+	int64_t schedulerTimeout;
+	int64_t now;				// us
+	int64_t tickEnd;
+	int64_t tick;
+	int64_t run;
+	int64_t ideal;
+	int64_t resetTime;
+	uint32_t done = 0;
+	uint32_t i;
+	SimResult result = {0};
+
+	// The pass that handles the start command begins startOffset into tick 0
+	for(i = 0; i < LEDn; i++) {
+		startTime[i] = 0;
+		resetTime = (startOffset + (int64_t)(i + 1) * START_COST) / 1000;
+		expiry[i] = (mode == RESET_FROM_TICK_COUNT ? resetTime : startTime[i]) + getCoffeePeriod((Coffee)i);
+		if(expiry[i] != startTime[i] + getCoffeePeriod((Coffee)i)) {
+			result.lateStarts++;
+		}
+		chimeFrom[i] = (int64_t)getBrewDurations((Coffee)i) * 1000;
+		chimeUntil[i] = chimeFrom[i] + CHIME_TIME;
+	}
+	schedulerTimeout = SCHEDULER_DELAY;
+
+	for(tick = 1; done < LEDn; tick++) {
+		now = tick * 1000 + TICK_COST;
+		tickEnd = (tick + 1) * 1000;
+
+		// Skip ahead to the next tick that has a timer due or a pass to make. Mixing takes
+		// well under a tick, so it only matters on those ticks
+		if(soundBacklog == 0 && schedulerBacklog == 0) {
+			run = schedulerTimeout;
+			for(i = 0; i < LEDn; i++) {
+				if(expiry[i] < run) {
+					run = expiry[i];
+				}
+			}
+			if(run > tick) {
+				tick = run;
+				now = tick * 1000 + TICK_COST;
+				tickEnd = (tick + 1) * 1000;
+			}
+		}
+
+		// The sound service mixes a DMA half whenever one finishes while a chime plays,
+		// which is counted from the start of the tick
+		while(nextMix < tickEnd) {
+			for(i = 0; i < LEDn && nextMix >= tick * 1000; i++) {
+				if(chimeFrom[i] <= nextMix && nextMix < chimeUntil[i]) {
+					soundBacklog += MIX_COST;
+					break;
+				}
+			}
+			nextMix += MIX_PERIOD;
+		}
+		if(tick >= schedulerTimeout && schedulerBacklog == 0) {
+			schedulerBacklog = passCost;
+		}
+
+		// Run the ready work, highest priority first, until the next tick
+		while(now < tickEnd) {
+			if(soundBacklog > 0) {
+				run = soundBacklog < tickEnd - now ? soundBacklog : tickEnd - now;
+				soundBacklog -= run;
+				now += run;
+			} else if(schedulerBacklog > 0) {
+				run = schedulerBacklog < tickEnd - now ? schedulerBacklog : tickEnd - now;
+				schedulerBacklog -= run;
+				now += run;
+				if(schedulerBacklog == 0) {
+					schedulerTimeout = tick + SCHEDULER_DELAY;
+				}
+			} else {
+				// The daemon handles the timer that is due first
+				run = LEDn;
+				for(i = 0; i < LEDn; i++) {
+					if(expiry[i] <= tick && (run == LEDn || expiry[i] < expiry[run])) {
+						run = i;
+					}
+				}
+				if(run == LEDn || releases[run] == RELEASES) {
+					if(run != LEDn) {
+						expiry[run] = 0x7FFFFFFFFFFFFFFF;
+						done++;
+						continue;
+					}
+					break;
+				}
+
+				now += CALLBACK_COST;
+				expiry[run] += getCoffeePeriod((Coffee)run);
+				releases[run]++;
+				result.releases++;
+
+				// vReleaseTimerCallback stamps the release and reads the tick count
+				ideal = startTime[run] + (int64_t)releases[run] * getCoffeePeriod((Coffee)run);
+				if((uint32_t)(tick - ideal) > result.maxJitter) {
+					result.maxJitter = (uint32_t)(tick - ideal);
+				}
+				chimeFrom[run] = (ideal + getBrewDurations((Coffee)run)) * 1000;
+				chimeUntil[run] = chimeFrom[run] + CHIME_TIME;
+
+				// and the release wakes the scheduler
+				schedulerBacklog = passCost;
+			}
+		}
+	}
+
+	for(i = 0; i < LEDn; i++) {
+		if(releases[i] != RELEASES) {
+			result.wrongCount++;
+		}
+	}
+	return result;
+}
+
+int main(void) {
+	SimResult result;
+	SimResult total;
+	uint32_t costIndex;
+	uint32_t offset;
+	uint32_t mode;
+
+	printf("%d releases of each coffee per run, started at %d points in a tick\n\n", RELEASES, START_OFFSETS);
+	printf("pass us  timer reset from   releases  late starts  wrong counts  max jitter (ticks)\n");
+	for(costIndex = 0; costIndex < sizeof(PASS_COSTS) / sizeof(PASS_COSTS[0]); costIndex++) {
+		for(mode = RESET_FROM_TICK_COUNT; mode <= RESET_FROM_START_TIME; mode++) {
+			total.releases = 0;
+			total.maxJitter = 0;
+			total.lateStarts = 0;
+			total.wrongCount = 0;
+			for(offset = 0; offset < START_OFFSETS; offset++) {
+				result = simulate(PASS_COSTS[costIndex], offset * 1000 / START_OFFSETS, (ResetMode)mode);
+				total.releases += result.releases;
+				total.lateStarts += result.lateStarts;
+				total.wrongCount += result.wrongCount;
+				if(result.maxJitter > total.maxJitter) {
+					total.maxJitter = result.maxJitter;
+				}
+			}
+			printf("%7lld  %-16s  %9u  %11u  %12u  %18u%s\n", (long long)PASS_COSTS[costIndex],
+				mode == RESET_FROM_TICK_COUNT ? "tick count" : "startTime", total.releases, total.lateStarts,
+				total.wrongCount, total.maxJitter, total.maxJitter > 1 || total.wrongCount > 0 ? "  OVER" : "");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Host side check of CONSTANT_BANDWIDTH_SERVER: brews of one coffee are made to take
+ * longer than getBrewDurations, and the missed deadlines of every coffee are counted
+ * under plain EDF and under EDF with a Constant Bandwidth Server reservation per
+ * coffee. With the reservations only the coffee that overruns should miss anything.
+ *
+ * The catalog is scheduled with an ideal, millisecond granularity scheduler, with the
+ * coffees released 5 s apart so that nothing is missed without overruns. The
+ * reservations are charged either every ms or, like on the board, only at the
+ * scheduling passes, which come on every release and otherwise every SCHEDULER_DELAY.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/reservation_sim.c Source/job.c Source/coffee.c -o reservation_sim && ./reservation_sim
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+#include "coffee.h"
+#include "job.h"
+
+// The same value as main.c
+#define SCHEDULER_DELAY 1000
+
+// ms simulated for each run
+#define SIM_TIME 1200000
+
+// When each coffee's first job is released
+static const int32_t PHASES[LEDn] = {0, 5000, 10000, 15000};
+
+typedef struct {
+	const char *name;
+	Coffee coffee;		// the one that overruns
+	int32_t overrun;	// extra ms
+	uint32_t every;		// on every this many-th brew
+} Scenario;
+
+static const Scenario SCENARIOS[] = {
+	{"no overruns", MOCHA, 0, 1},
+	{"mocha +1 s every brew", MOCHA, 1000, 1},
+	{"mocha +3 s every brew", MOCHA, 3000, 1},
+	{"mocha +12 s every 4th brew", MOCHA, 12000, 4},
+	{"mocha +30 s every brew", MOCHA, 30000, 1},
+	{"espresso +2 s every brew", ESPRESSO, 2000, 1},
+	{"latte +20 s every 2nd brew", LATTE, 20000, 2}
+};
+
+typedef enum {
+	PLAIN_EDF,
+	RESERVATIONS_EXACT,
+	RESERVATIONS_PER_PASS
+} Policy;
+
+typedef struct {
+	uint32_t missed[LEDn];		// finished late, dropped or still waiting past the deadline at the end
+	uint32_t postponements;
+} SimResult;
+
+static int32_t reservationBudget[LEDn];
+static int32_t reservationDeadline[LEDn];
+
+/*
+ * The same wake up rule as wakeReservation.
+ */
+static void wakeReservation(Coffee type, int32_t now, int32_t deadline) {
+	int32_t budget = (int32_t)getReservationBudget(type);
+	int32_t period = (int32_t)getReservationPeriod(type);
+
+	if((int64_t)reservationBudget[type] * period >= (int64_t)(reservationDeadline[type] - now) * budget) {
+		reservationBudget[type] = budget;
+		reservationDeadline[type] = deadline;
+	}
+}
+
+/*
+ * The same budget rule as chargeReservation. Returns how many times the deadline was
+ * put back.
+ */
+static uint32_t chargeReservation(JobRing *rings, Coffee type, int32_t used) {
+	int32_t budget = (int32_t)getReservationBudget(type);
+	int32_t period = (int32_t)getReservationPeriod(type);
+	uint32_t postponements = 0;
+
+	reservationBudget[type] -= used;
+	while(reservationBudget[type] < 0 || (reservationBudget[type] == 0 && rings[type].count > 0)) {
+		reservationBudget[type] += budget;
+		reservationDeadline[type] += period;
+		postponements++;
+	}
+	return postponements;
+}
+
+static SimResult simulate(const Scenario *scenario, Policy policy) {
+	static JobPool pool;
+	static JobRing rings[LEDn];
+	uint32_t releases[LEDn] = {0};
+	int32_t used[LEDn] = {0};		// brewed since the reservation was last charged
+	int32_t nextPass = 0;
+	uint32_t released;
+	SimResult result = {{0}};
+	int32_t work;
+	int32_t deadline;
+	int32_t best = 0;
+	uint32_t brewing;
+	Job *job;
+	int32_t t;
+	uint32_t i;
+
+	initJobPool(&pool);
+	for(i = 0; i < LEDn; i++) {
+		initJobRing(&rings[i], &pool);
+		reservationBudget[i] = 0;
+		reservationDeadline[i] = 0;
+	}
+
+	for(t = 0; t < SIM_TIME; t++) {
+		released = 0;
+		for(i = 0; i < LEDn; i++) {
+			if(t < PHASES[i] || (t - PHASES[i]) % getCoffeePeriod((Coffee)i) != 0) {
+				continue;
+			}
+			work = (int32_t)getBrewDurations((Coffee)i);
+			if(i == scenario->coffee && releases[i] % scenario->every == scenario->every - 1) {
+				work += scenario->overrun;
+			}
+			releases[i]++;
+			released = 1;
+
+			if(policy != PLAIN_EDF && rings[i].count == 0) {
+				wakeReservation((Coffee)i, t, t + (int32_t)getCoffeeDeadline((Coffee)i));
+			}
+			if(!pushJob(&rings[i], t, t + getCoffeeDeadline((Coffee)i), work)) {
+				result.missed[i]++;
+			}
+		}
+
+		if(policy == RESERVATIONS_EXACT || (policy == RESERVATIONS_PER_PASS && (released || t >= nextPass))) {
+			for(i = 0; i < LEDn; i++) {
+				if(used[i] > 0) {
+					result.postponements += chargeReservation(rings, (Coffee)i, used[i]);
+					used[i] = 0;
+				}
+			}
+			nextPass = t + SCHEDULER_DELAY;
+		}
+
+		brewing = LEDn;
+		for(i = 0; i < LEDn; i++) {
+			job = peekJob(&rings[i]);
+			if(job == NULL) {
+				continue;
+			}
+			deadline = policy == PLAIN_EDF ? job->deadline : reservationDeadline[i];
+			if(brewing == LEDn || deadline < best) {
+				brewing = i;
+				best = deadline;
+			}
+		}
+		if(brewing == LEDn) {
+			continue;
+		}
+
+		job = peekJob(&rings[brewing]);
+		job->remainingWork--;
+		used[brewing]++;
+		if(job->remainingWork <= 0) {
+			if(t + 1 > job->deadline) {
+				result.missed[brewing]++;
+			}
+			popJob(&rings[brewing]);
+		}
+	}
+
+	for(i = 0; i < LEDn; i++) {
+		while((job = peekJob(&rings[i])) != NULL) {
+			if(job->deadline < SIM_TIME) {
+				result.missed[i]++;
+			}
+			popJob(&rings[i]);
+		}
+	}
+	return result;
+}
+
+int main(void) {
+	static const char *POLICY_NAMES[] = {"EDF", "EDF + CBS, exact", "EDF + CBS, per pass"};
+	uint32_t scenario;
+	uint32_t policy;
+	uint32_t others;
+	SimResult result;
+	uint32_t i;
+
+	printf("Missed deadlines in %d s, latte/espresso/mocha/cappuccino\n\n", SIM_TIME / 1000);
+	for(scenario = 0; scenario < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); scenario++) {
+		printf("%s\n", SCENARIOS[scenario].name);
+		printf("policy                 missed               postponed  others missed\n");
+		for(policy = PLAIN_EDF; policy <= RESERVATIONS_PER_PASS; policy++) {
+			result = simulate(&SCENARIOS[scenario], (Policy)policy);
+			others = 0;
+			for(i = 0; i < LEDn; i++) {
+				if(i != SCENARIOS[scenario].coffee) {
+					others += result.missed[i];
+				}
+			}
+			printf("%-21s  %4u/%4u/%4u/%4u  %9u  %13u%s\n", POLICY_NAMES[policy], result.missed[LATTE],
+				result.missed[ESPRESSO], result.missed[MOCHA], result.missed[CAPPUCCINO], result.postponements,
+				others, policy != PLAIN_EDF && others > 0 ? "  NOT ISOLATED" : "");
+		}
+		printf("\n");
+	}
+	return 0;
+}
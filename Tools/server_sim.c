@@ -0,0 +1,391 @@
+/*
+ * Host side simulation of one-off orders on top of the periodic coffee.c catalog,
+ * served each of the ways main.c can serve them. The periodic coffees are scheduled
+ * EDF with an ideal, millisecond granularity scheduler, and their releases are
+ * spread out so that none of them is missed without orders. Orders come in at
+ * pseudo random times for a random coffee and, like on the board, wait in that
+ * coffee's job ring behind its periodic jobs until they start. An order only starts
+ * if it can finish before its coffee is next released, and one that has started
+ * brews early enough for any periodic job stuck behind it, as main.c does.
+ *
+ * The servers are sized the way main.c sizes them, by partition.c's demand test with
+ * the releases spread out as they are here. A deferrable or sporadic server's order
+ * is scheduled by the time its budget comes back and a total bandwidth server's by
+ * the deadline its share gives it.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/server_sim.c Source/job.c Source/coffee.c Source/partition.c -o server_sim && ./server_sim
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+#include "coffee.h"
+#include "job.h"
+#include "partition.h"
+
+// The same values as main.c
+#define SERVER_PERIOD 10000
+#define SPORADIC_REPLENISHMENTS 8
+
+// ms simulated for each run
+#define SIM_TIME 3600000
+
+// When each coffee's first periodic job is released
+static const uint32_t PHASES[LEDn] = {0, 5000, 10000, 15000};
+
+// The catalog's hyperperiod, and how far apart the bursts of orders are tried, ms
+#define HYPERPERIOD 120000
+#define BURST_STEP 250
+#define BURST_WORK 4000
+
+// Mean time between orders, ms
+static const int32_t ORDER_GAPS[] = {0, 120000, 60000, 30000};
+
+typedef enum {
+	AS_JOBS,
+	BACKGROUND,
+	DEFERRABLE,
+	SPORADIC,
+	TOTAL_BANDWIDTH,
+	SPARE_BANDWIDTH
+} Service;
+
+static const char *BURST_NAMES[] = {"Deferrable, sized sporadic", "Deferrable", "Sporadic"};
+
+static const char *SERVICE_NAMES[] = {"As periodic jobs", "Background", "Deferrable server",
+	"Sporadic server", "Total bandwidth server", "TBS with 1 - U"};
+
+typedef struct {
+	uint32_t orders;
+	uint32_t completedOrders;
+	uint32_t droppedOrders;
+	uint32_t meanResponse;
+	uint32_t maxResponse;
+	uint32_t maxServerUse;	// the most the server brewed in any SERVER_PERIOD
+	uint32_t missed;		// periodic jobs finished late, dropped or still waiting past the deadline at the end
+} SimResult;
+
+typedef struct {
+	int32_t time;
+	int32_t amount;
+} Replenishment;
+
+static uint32_t seed;
+
+/*
+ * Numerical Recipes' linear congruential generator, so every run sees the same orders.
+ */
+static uint32_t nextRandom(void) {
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+// The servers' budgets and the total bandwidth server's share of each period, ms. The
+// last row gives a total bandwidth server all the capacity the catalog leaves, which
+// is only safe when every deadline is the period
+static int32_t deferrableBudget;
+static int32_t sporadicBudget;
+static int32_t bandwidthBudget;
+static int32_t spareBudget;
+
+/*
+ * Which band a coffee's oldest job is scheduled in: 0 for a periodic job or an order
+ * scheduled by a deadline, 1 for an order in the background. Within band 0 it goes
+ * by *deadline, which for an order the server has budget for is when the budget
+ * comes back.
+ */
+static uint32_t getOrderBand(Service service, Job *job, int32_t budget, int32_t t, int32_t activeSince,
+		int32_t *deadline) {
+	*deadline = job->deadline;
+	if(service == AS_JOBS) {
+		return 0;
+	}
+	if(service == TOTAL_BANDWIDTH || service == SPARE_BANDWIDTH) {
+		return job->deadline != 0x7FFFFFFF ? 0 : 1;
+	}
+	if(service == BACKGROUND || budget <= 0) {
+		return 1;
+	}
+	if(service == DEFERRABLE) {
+		*deadline = (t / SERVER_PERIOD + 1) * SERVER_PERIOD;
+	} else {
+		*deadline = (activeSince >= 0 ? activeSince : t) + SERVER_PERIOD;
+	}
+	return 0;
+}
+
+/*
+ * The band and deadline a coffee's oldest job is scheduled by. As in main.c, a
+ * started order with a periodic job stuck behind it brews by that job's deadline if
+ * it would otherwise brew later.
+ */
+static uint32_t getBand(Service service, JobRing *ring, int32_t budget, int32_t t, int32_t activeSince,
+		int32_t *deadline) {
+	Job *job = peekJob(ring);
+	Job *next = peekNextJob(ring);
+	uint32_t band;
+
+	if(!job->aperiodic) {
+		*deadline = job->deadline;
+		return 0;
+	}
+	band = getOrderBand(service, job, budget, t, activeSince, deadline);
+	if(job->startTime != JOB_NOT_STARTED && next != NULL && !next->aperiodic &&
+			(band != 0 || next->deadline - next->remainingWork < *deadline)) {
+		*deadline = next->deadline - next->remainingWork;
+		band = 0;
+	}
+	return band;
+}
+
+/*
+ * When a coffee's next periodic job is released after t.
+ */
+static int32_t getNextRelease(Coffee type, int32_t t) {
+	int32_t phase = (int32_t)PHASES[type];
+	int32_t period = (int32_t)getCoffeePeriod(type);
+
+	if(t < phase) {
+		return phase;
+	}
+	return phase + ((t - phase) / period + 1) * period;
+}
+
+/*
+ * Run the catalog for simTime ms with orders every orderGap ms on average, or with
+ * one BURST_WORK ms order at burstAt if that isn't -1. The burst has a ring of its
+ * own, so it never holds up a periodic job of its coffee and only the server decides
+ * when it brews. serverBudget is the deferrable or sporadic server's.
+ */
+static SimResult simulate(Service service, int32_t orderGap, int32_t serverBudget, int32_t burstAt,
+		int32_t simTime) {
+	static JobPool pool;
+	static JobRing rings[LEDn + 1];
+	static uint8_t window[SERVER_PERIOD];	// whether the server brewed, for the last period
+	uint32_t windowUse = 0;
+	Replenishment replenishments[SPORADIC_REPLENISHMENTS];
+	uint32_t replenishmentCount = 0;
+	int32_t budget = serverBudget;
+	int32_t activeSince = -1;		// when the sporadic server started brewing what it has used since
+	int32_t bandwidthDeadline = 0;
+	int32_t nextOrder;
+	uint64_t totalResponse = 0;
+	SimResult result = {0};
+	Coffee type;
+	uint32_t brewing;
+	uint32_t band;
+	uint32_t bestBand = 0;
+	int32_t deadline;
+	int32_t bestDeadline = 0;
+	int32_t share = service == SPARE_BANDWIDTH ? spareBudget : bandwidthBudget;
+	int32_t used;
+	Job *job;
+	int32_t t;
+	uint32_t i;
+
+	seed = 1;
+	used = 0;
+	nextOrder = orderGap > 0 ? (int32_t)(nextRandom() % (2 * orderGap)) : simTime;
+	initJobPool(&pool);
+	for(i = 0; i <= LEDn; i++) {
+		initJobRing(&rings[i], &pool);
+	}
+
+	for(t = 0; t < SERVER_PERIOD; t++) {
+		window[t] = 0;
+	}
+
+	for(t = 0; t < simTime; t++) {
+		windowUse -= window[t % SERVER_PERIOD];
+		window[t % SERVER_PERIOD] = 0;
+
+		for(i = 0; i < LEDn; i++) {
+			if(t >= (int32_t)PHASES[i] && (t - (int32_t)PHASES[i]) % getCoffeePeriod((Coffee)i) == 0 &&
+					!pushJob(&rings[i], t, t + getCoffeeDeadline((Coffee)i), getBrewDurations((Coffee)i))) {
+				result.missed++;
+			}
+		}
+
+		if(t == burstAt) {
+			result.orders++;
+			pushOrder(&rings[LEDn], t, t + BURST_WORK, BURST_WORK);
+		}
+		if(t == nextOrder) {
+			type = (Coffee)(nextRandom() % LEDn);
+			result.orders++;
+			if(service == TOTAL_BANDWIDTH || service == SPARE_BANDWIDTH) {
+				if(bandwidthDeadline < t) {
+					bandwidthDeadline = t;
+				}
+				bandwidthDeadline = share > 0 ? bandwidthDeadline + getBrewDurations(type) * SERVER_PERIOD / share :
+					0x7FFFFFFF;
+			}
+			if(!pushOrder(&rings[type], t, service >= TOTAL_BANDWIDTH ? bandwidthDeadline :
+					t + (int32_t)getCoffeeDeadline(type), getBrewDurations(type))) {
+				result.droppedOrders++;
+			}
+			nextOrder = t + 1 + (int32_t)(nextRandom() % (2 * orderGap));
+		}
+
+		if(service == DEFERRABLE && t % SERVER_PERIOD == 0) {
+			budget = serverBudget;
+		}
+		if(service == SPORADIC) {
+			for(i = 0; i < replenishmentCount; ) {
+				if(t >= replenishments[i].time) {
+					budget += replenishments[i].amount;
+					replenishments[i] = replenishments[--replenishmentCount];
+				} else {
+					i++;
+				}
+			}
+		}
+
+		// As in main.c an order only starts if it can finish before its coffee is next
+		// released
+		brewing = LEDn + 1;
+		for(i = 0; i <= LEDn; i++) {
+			job = peekJob(&rings[i]);
+			if(job == NULL || (i < LEDn && job->aperiodic && job->startTime == JOB_NOT_STARTED &&
+					t + job->remainingWork > getNextRelease((Coffee)i, t))) {
+				continue;
+			}
+			band = getBand(service, &rings[i], budget, t, activeSince, &deadline);
+			if(brewing == LEDn + 1 || band < bestBand || (band == bestBand && deadline < bestDeadline)) {
+				brewing = i;
+				bestBand = band;
+				bestDeadline = deadline;
+			}
+		}
+
+		// The sporadic server gets back what it used a period after it started using it,
+		// once it stops brewing
+		if(service == SPORADIC && activeSince >= 0 && (brewing == LEDn + 1 || bestBand != 0 || budget <= 0 ||
+				!peekJob(&rings[brewing])->aperiodic)) {
+			if(replenishmentCount == SPORADIC_REPLENISHMENTS) {
+				replenishments[replenishmentCount - 1].amount += used;
+			} else {
+				replenishments[replenishmentCount].time = activeSince + SERVER_PERIOD;
+				replenishments[replenishmentCount].amount = used;
+				replenishmentCount++;
+			}
+			activeSince = -1;
+			used = 0;
+		}
+
+		if(brewing == LEDn + 1) {
+			continue;
+		}
+		job = peekJob(&rings[brewing]);
+		if(job->startTime == JOB_NOT_STARTED) {
+			job->startTime = t;
+		}
+		if((service == DEFERRABLE || service == SPORADIC) && budget > 0 && bestBand == 0 && job->aperiodic) {
+			budget--;
+			if(activeSince < 0) {
+				activeSince = t;
+			}
+			used++;
+			window[t % SERVER_PERIOD] = 1;
+			windowUse++;
+			if(windowUse > result.maxServerUse) {
+				result.maxServerUse = windowUse;
+			}
+		}
+
+		job->remainingWork--;
+		if(job->remainingWork <= 0) {
+			if(job->aperiodic) {
+				result.completedOrders++;
+				totalResponse += (uint32_t)(t + 1 - job->release);
+				if((uint32_t)(t + 1 - job->release) > result.maxResponse) {
+					result.maxResponse = (uint32_t)(t + 1 - job->release);
+				}
+			} else if(t + 1 > job->deadline) {
+				result.missed++;
+			}
+			popJob(&rings[brewing]);
+		}
+	}
+
+	for(i = 0; i <= LEDn; i++) {
+		while((job = peekJob(&rings[i])) != NULL) {
+			if(!job->aperiodic && job->deadline < simTime) {
+				result.missed++;
+			}
+			popJob(&rings[i]);
+		}
+	}
+	if(result.completedOrders > 0) {
+		result.meanResponse = (uint32_t)(totalResponse / result.completedOrders);
+	}
+	return result;
+}
+
+int main(void) {
+	BrewLoad loads[LEDn];
+	uint32_t gap;
+	uint32_t service;
+	SimResult result;
+	double spare = 1.0;
+	int32_t budget;
+	uint32_t mostUsed;
+	uint32_t missedBursts;
+	uint32_t missed;
+	int32_t t;
+	uint32_t i;
+
+	for(i = 0; i < LEDn; i++) {
+		loads[i].work = getBrewDurations((Coffee)i);
+		loads[i].deadline = getCoffeeDeadline((Coffee)i);
+		loads[i].period = getCoffeePeriod((Coffee)i);
+		spare -= (double)loads[i].work / loads[i].period;
+	}
+	deferrableBudget = (int32_t)getServerBudget(loads, PHASES, LEDn, SERVER_PERIOD, SERVER_DEFERRABLE);
+	sporadicBudget = (int32_t)getServerBudget(loads, PHASES, LEDn, SERVER_PERIOD, SERVER_SPORADIC);
+	bandwidthBudget = (int32_t)getServerBudget(loads, PHASES, LEDn, SERVER_PERIOD, SERVER_TOTAL_BANDWIDTH);
+	spareBudget = (int32_t)(spare * SERVER_PERIOD);
+	printf("Every %d ms: deferrable budget %d ms, sporadic budget %d ms, total bandwidth share %d ms, "
+		"%d ms left by the catalog\n\n", SERVER_PERIOD, deferrableBudget, sporadicBudget, bandwidthBudget, spareBudget);
+
+	for(gap = 0; gap < sizeof(ORDER_GAPS) / sizeof(ORDER_GAPS[0]); gap++) {
+		if(ORDER_GAPS[gap] == 0) {
+			printf("No orders, %d s\n", SIM_TIME / 1000);
+		} else {
+			printf("An order every %d s on average, %d s\n", ORDER_GAPS[gap] / 1000, SIM_TIME / 1000);
+		}
+		printf("service                   orders  done  dropped  mean ms   max ms  periodic missed\n");
+		for(service = AS_JOBS; service <= SPARE_BANDWIDTH; service++) {
+			result = simulate((Service)service, ORDER_GAPS[gap],
+				service == SPORADIC ? sporadicBudget : deferrableBudget, -1, SIM_TIME);
+			printf("%-24s  %6u  %4u  %7u  %7u  %7u  %15u\n", SERVICE_NAMES[service], result.orders,
+				result.completedOrders, result.droppedOrders, result.meanResponse, result.maxResponse, result.missed);
+		}
+		printf("\n");
+	}
+
+	// A deferrable server can spend its budget at the end of one period and again at
+	// the start of the next, which a long order at each time through a hyperperiod
+	// shows. partition.c sizes it for that, where a sporadic server can't do it
+	printf("One %d ms order, at every %d ms through a hyperperiod\n", BURST_WORK, BURST_STEP);
+	printf("server                      budget ms  most in a period  bursts with a miss  periodic missed\n");
+	for(i = 0; i < 3; i++) {
+		budget = i == 1 ? deferrableBudget : sporadicBudget;
+		mostUsed = 0;
+		missedBursts = 0;
+		missed = 0;
+		for(t = 0; t < HYPERPERIOD; t += BURST_STEP) {
+			result = simulate(i == 2 ? SPORADIC : DEFERRABLE, 0, budget, t, t + 2 * HYPERPERIOD);
+			if(result.maxServerUse > mostUsed) {
+				mostUsed = result.maxServerUse;
+			}
+			missedBursts += result.missed > 0;
+			missed += result.missed;
+		}
+		printf("%-26s  %9d  %16u  %18u  %15u\n", BURST_NAMES[i], budget, mostUsed, missedBursts, missed);
+	}
+	return 0;
+}
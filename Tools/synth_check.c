@@ -0,0 +1,152 @@
+/*
+ * Host side check of synth.c against the original chime renderer: the double
+ * precision saw wave and per sample float FIR that sound.c played before the block
+ * renderer replaced it. Both render SAMPLES samples and every sample that differs is
+ * counted. It also times both, although host timings say little about the M4, where
+ * SOUND_BENCHMARK does the same.
+ *
+ * The check passes if, at the note the original played, no sample is more than 1 LSB
+ * out, which is all the Q15 filter taps can promise. The coffees' chime pitches are
+ * shown too, but the original never played them, and where the step is exact in
+ * binary (cappuccino's 0.0125) its double accumulator lands exactly on 1.0 and wraps
+ * a sample later than synth.c's phase. That shifts the chime by one sample without
+ * changing how it sounds.
+ *
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -O2 -DUSE_STDPERIPH_DRIVER -DSTM32F40_41xx -I Source -I Include \
+ *     -I Libraries/CMSIS/Include -I Libraries/CMSIS/Device/ST/STM32F4xx/Include \
+ *     -I Libraries/STM32F4xx_StdPeriph_Driver/inc \
+ *     Tools/synth_check.c Source/synth.c Source/coffee.c -o synth_check && ./synth_check
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "coffee.h"
+#include "synth.h"
+
+// The same values as the original sound.c
+#define NOTEFREQUENCY 0.015
+#define NOTEAMPLITUDE 500.0
+#define SAMPLE_RATE 48000
+
+// Samples rendered for each pitch
+#define SAMPLES 200000
+
+typedef struct {
+	float tabs[8];
+	float params[8];
+	uint8_t currIndex;
+} fir_8;
+
+/*
+ * initFilter and updateFilter as they were in sound.c.
+ */
+static void initFilter(fir_8* theFilter) {
+	uint8_t i;
+
+	theFilter->currIndex = 0;
+
+	for (i=0; i<8; i++)
+		theFilter->tabs[i] = 0.0;
+
+	theFilter->params[0] = 0.01;
+	theFilter->params[1] = 0.05;
+	theFilter->params[2] = 0.12;
+	theFilter->params[3] = 0.32;
+	theFilter->params[4] = 0.32;
+	theFilter->params[5] = 0.12;
+	theFilter->params[6] = 0.05;
+	theFilter->params[7] = 0.01;
+}
+
+static float updateFilter(fir_8* filt, float val) {
+	uint16_t valIndex;
+	uint16_t paramIndex;
+	float outval = 0.0;
+
+	valIndex = filt->currIndex;
+	filt->tabs[valIndex] = val;
+
+	for (paramIndex=0; paramIndex<8; paramIndex++) {
+		outval += (filt->params[paramIndex]) * (filt->tabs[(valIndex+paramIndex)&0x07]);
+	}
+
+	valIndex++;
+	valIndex &= 0x07;
+
+	filt->currIndex = valIndex;
+
+	return outval;
+}
+
+/*
+ * The sample loop of the original playSound, one sample per L/R pair.
+ */
+static void renderReference(double noteFrequency, int16_t *out, uint32_t count) {
+	fir_8 filt;
+	double sawWave = 0.0;
+	double filteredSaw;
+	uint32_t i;
+
+	initFilter(&filt);
+	for(i = 0; i < count; i++) {
+		sawWave += noteFrequency;
+		if (sawWave > 1.0) {
+			sawWave -= 2.0;
+		}
+		filteredSaw = updateFilter(&filt, sawWave);
+		out[i] = (int16_t)(NOTEAMPLITUDE*filteredSaw);
+	}
+}
+
+/*
+ * Render one pitch both ways. Returns the largest difference.
+ */
+static uint32_t check(const char *name, double noteFrequency) {
+	static int16_t reference[SAMPLES];
+	static int16_t rendered[SAMPLES];
+	Synth synth;
+	uint32_t mismatches = 0;
+	uint32_t maxError = 0;
+	uint32_t error;
+	clock_t referenceTime;
+	clock_t synthTime;
+	uint32_t i;
+
+	referenceTime = clock();
+	renderReference(noteFrequency, reference, SAMPLES);
+	referenceTime = clock() - referenceTime;
+
+	synthTime = clock();
+	initSynth(&synth, (float)noteFrequency, NOTEAMPLITUDE);
+	renderSynth(&synth, rendered, SAMPLES);
+	synthTime = clock() - synthTime;
+
+	for(i = 0; i < SAMPLES; i++) {
+		error = reference[i] > rendered[i] ? reference[i] - rendered[i] : rendered[i] - reference[i];
+		if(error > 0) {
+			mismatches++;
+		}
+		if(error > maxError) {
+			maxError = error;
+		}
+	}
+
+	printf("%-12s  %10.5f  %10u  %9u  %12.1f  %8.1f\n", name, noteFrequency, mismatches, maxError,
+		1e9 * referenceTime / CLOCKS_PER_SEC / SAMPLES, 1e9 * synthTime / CLOCKS_PER_SEC / SAMPLES);
+	return maxError;
+}
+
+int main(void) {
+	uint32_t maxError;
+	uint32_t i;
+
+	printf("%d samples per pitch\n", SAMPLES);
+	printf("pitch         step        mismatches  max error  reference ns  synth ns\n");
+	maxError = check("original", NOTEFREQUENCY);
+	for(i = 0; i < LEDn; i++) {
+		check(getCoffeeName((Coffee)i), 2.0 * getCoffeeChimeFrequency((Coffee)i) / SAMPLE_RATE);
+	}
+	printf("%s\n", maxError <= 1 ? "within 1 LSB of the original renderer" : "MORE than 1 LSB from the original renderer");
+	return maxError > 1;
+}